@@ -0,0 +1,108 @@
+#ifndef __ARENA__
+#define __ARENA__
+
+#include <vector>
+#include <memory>
+#include <cstdlib>
+#include <cstdint>
+
+#ifdef __unix__
+	#include <mutex>
+	#include <sys/mman.h>
+#endif
+
+typedef unsigned char	uchar;
+
+//Raw scratch memory, optionally backed by transparent huge pages
+class ScratchMemory {
+	public:
+		static bool		hugePages;
+
+		static constexpr size_t	HUGE_PAGE	= 2 * 1024 * 1024;
+
+		static uchar* Allocate(size_t bytes) {
+#ifdef __unix__
+			void*	data	= nullptr;
+			if(hugePages and bytes >= HUGE_PAGE) {
+				bytes	= (bytes + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+				if(posix_memalign(&data, HUGE_PAGE, bytes) not_eq 0)
+					return nullptr;
+				madvise(data, bytes, MADV_HUGEPAGE);
+			} else {
+				data	= malloc(bytes);
+			}
+			return static_cast<uchar*>(data);
+#else
+			return static_cast<uchar*>(malloc(bytes));
+#endif
+		}
+		static void Free(uchar* data) {
+			free(data);
+		}
+};
+inline bool ScratchMemory::hugePages	= false;
+
+/*
+	Thread safe pool of reusable objects (grids, mesh buffers), objects
+	keep their allocations when returned so next file skips allocation
+	and page faulting. Pool holds at most as many objects as were in use
+	at once, with limit also at most that many bytes (T::Footprint), any
+	object that does not fit is freed on return.
+*/
+template<typename T>
+class ObjectPool {
+	private:
+		std::vector<std::unique_ptr<T>>	available;
+		std::vector<size_t>				footprints;
+		size_t							limit		= SIZE_MAX;
+		size_t							retained	= 0;
+#ifdef __unix__
+		std::mutex						lock;
+#endif
+
+	public:
+		std::unique_ptr<T> Acquire() {
+#ifdef __unix__
+			std::lock_guard<std::mutex>	guard(lock);
+#endif
+			if(available.empty())
+				return std::unique_ptr<T>(new T());
+
+			std::unique_ptr<T>	object	= std::move(available.back());
+			available.pop_back();
+			retained	-= footprints.back();
+			footprints.pop_back();
+			return object;
+		}
+
+		void Release(std::unique_ptr<T> object) {
+			if(not object)
+				return;
+			size_t	bytes	= object->Footprint();
+			{
+#ifdef __unix__
+				std::lock_guard<std::mutex>	guard(lock);
+#endif
+				if(bytes > limit - retained)
+					return;	//Freed outside of lock
+				available.push_back(std::move(object));
+				footprints.push_back(bytes);
+				retained	+= bytes;
+			}
+		}
+
+		//Caps bytes kept between uses (memory limit), frees pooled objects over it
+		void Limit(size_t bytes) {
+#ifdef __unix__
+			std::lock_guard<std::mutex>	guard(lock);
+#endif
+			limit	= bytes;
+			while(retained > limit) {
+				retained	-= footprints.back();
+				footprints.pop_back();
+				available.pop_back();
+			}
+		}
+};
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef __COLLISION__
+#define __COLLISION__
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+
+#include "VOX.h"
+
+/*
+	Collider of model as axis aligned boxes. Occupancy of Unity oriented
+	grid is kept as bit rows (64 voxels along X per word) and boxes are
+	merged greedily: lowest set bit grows into run along X (word at a
+	time), run grows along Y while next rows hold all of it, then along
+	Z while every row of next slice does, and bits of box are cleared.
+	Boxes do not overlap and cover solid voxels exactly.
+*/
+class CollisionBoxes {
+	public:
+		struct Box {
+			vec<int>	min;	//First voxel
+			vec<int>	max;	//Past last voxel
+		};
+
+		std::vector<Box>	boxes;
+		vec<float>			origin;			//Mesh space position of voxel corner (0, 0, 0)
+		float				unit	= 1.0f;	//Mesh space size of voxel
+
+	private:
+		vec<int>				size;
+		int						words	= 0;	//Per row
+		std::vector<uint64_t>	bits;
+
+		inline uint64_t* Row(int y, int z) {
+			return &bits[(size_t(y) + size_t(size.y) * z) * words];
+		}
+
+		//Bits of voxels x0..x1 (exclusive) within word w
+		static inline uint64_t Span(int w, int x0, int x1) {
+			int		low		= std::max(x0 - w * 64, 0);
+			int		high	= std::min(x1 - w * 64, 64);
+			if(low >= high)
+				return 0;
+			return (high == 64? ~uint64_t(0): (uint64_t(1) << high) - 1) & (~uint64_t(0) << low);
+		}
+
+		bool Holds(int y, int z, int x0, int x1) {
+			uint64_t*	row	= Row(y, z);
+			for(int w = x0 >> 6; w <= (x1 - 1) >> 6; ++w) {
+				uint64_t	span	= Span(w, x0, x1);
+				if((row[w] & span) not_eq span)
+					return false;
+			}
+			return true;
+		}
+
+	public:
+		/*
+			Boxes of model in same space as mesh of LoadVoxels (flips,
+			scale, upscale and offset). Box faces are source voxel faces,
+			meshed surface lies half of upscaled voxel inside of them.
+		*/
+		void Build(
+			VOX& vox, const AxisTransform& transform = AxisTransform(),
+			float scale = 0.03125f, float upscale = 3.0f, vec<float> offset = vec<float>(0, 0, 0)
+		) {
+			VOX::TransformedView	view(vox, transform.Then(AxisTransform::MagicaToUnity()));
+			size	= view.Size();
+			words	= (size.x + 63) / 64;
+			bits.assign(size_t(words) * size.y * size.z, 0);
+
+			//Occupancy, every thread owns whole rows
+#ifdef __unix__
+			#pragma omp parallel for
+#endif
+			for(int z = 0; z < size.z; ++z) {
+				for(int y = 0; y < size.y; ++y) {
+					uint64_t*	row	= Row(y, z);
+					for(int x = 0; x < size.x; ++x)
+						if(view.Get(x, y, z) not_eq 0)
+							row[x >> 6]	|= uint64_t(1) << (x & 63);
+				}
+			}
+
+			boxes.clear();
+			for(int z = 0; z < size.z; ++z) {
+				for(int y = 0; y < size.y; ++y) {
+					uint64_t*	row	= Row(y, z);
+					for(int w = 0; w < words; ++w) {
+						while(row[w] not_eq 0) {
+							//Run along X ends at first empty voxel, padding bits are empty
+							int			x0		= w * 64 + __builtin_ctzll(row[w]);
+							int			end		= w;
+							uint64_t	empty	= ~row[w] & (~uint64_t(0) << (x0 & 63));
+							while(empty == 0 and ++end < words)
+								empty	= ~row[end];
+							int			x1		= std::min(size.x, end * 64 + (empty? __builtin_ctzll(empty): 0));
+
+							int			y1		= y + 1;
+							while(y1 < size.y and Holds(y1, z, x0, x1))
+								++y1;
+
+							int			z1		= z + 1;
+							for(bool grows = true; grows and z1 < size.z; z1 += grows) {
+								for(int r = y; r < y1 and grows; ++r)
+									grows	= Holds(r, z1, x0, x1);
+							}
+
+							for(int c = z; c < z1; ++c) {
+								for(int r = y; r < y1; ++r) {
+									uint64_t*	clear	= Row(r, c);
+									for(int k = x0 >> 6; k <= (x1 - 1) >> 6; ++k)
+										clear[k]	&= ~Span(k, x0, x1);
+								}
+							}
+							boxes.push_back({vec<int>(x0, y, z), vec<int>(x1, y1, z1)});
+						}
+					}
+				}
+			}
+			bits	= std::vector<uint64_t>();
+
+			//Voxel corners of LoadVoxels space, same centering as LoadVoxelsSurfaceNets
+			vec<int>	upSize(size.x * upscale, size.y * upscale, size.z * upscale);
+			vec<float>	center(upSize.x * 0.5f + upscale, upscale, upSize.z * 0.5f);
+			unit	= scale;
+			origin.Set(
+				(offset.x - center.x) * scale / upscale,
+				(offset.y - center.y) * scale / upscale,
+				(offset.z - center.z) * scale / upscale
+			);
+		}
+
+		//Picks format by extension: .json (min/max pairs), .bin or .obj (12 triangles per box)
+		bool Save(string path) {
+			string		ext	= path.substr(path.find_last_of('.') + 1);
+			ofstream	hFile(path, std::ios::trunc bitor std::ios::out bitor std::ios::binary);
+			if(hFile.fail())
+				return false;
+
+			auto	corner	= [&](const Box& box, int bits) -> vec<float> {
+				return vec<float>(
+					origin.x + ((bits & 1)? box.max.x: box.min.x) * unit,
+					origin.y + ((bits & 2)? box.max.y: box.min.y) * unit,
+					origin.z + ((bits & 4)? box.max.z: box.min.z) * unit
+				);
+			};
+
+			if(ext == "bin") {
+				//"VBOX", box count, then min XYZ & max XYZ as little endian floats
+				uint32_t	count	= boxes.size();
+				hFile.write("VBOX", 4);
+				hFile.write(reinterpret_cast<const char*>(&count), 4);
+				for(const Box& box : boxes) {
+					vec<float>	low		= corner(box, 0);
+					vec<float>	high	= corner(box, 7);
+					float		values[6]	= {low.x, low.y, low.z, high.x, high.y, high.z};
+					hFile.write(reinterpret_cast<const char*>(values), sizeof(values));
+				}
+			} else if(ext == "obj") {
+				//Corner bits are X | Y << 1 | Z << 2, faces wind like SaveOBJ ones
+				static const int	faces[12][3]	= {
+					{0, 1, 4}, {1, 5, 4},	{2, 6, 3}, {3, 6, 7},	//-Y, +Y
+					{0, 4, 2}, {2, 4, 6},	{1, 3, 5}, {3, 7, 5},	//-X, +X
+					{0, 2, 1}, {1, 2, 3},	{4, 5, 6}, {5, 7, 6}	//-Z, +Z
+				};
+				hFile	<< "g Collision\n";
+				for(const Box& box : boxes) {
+					for(int bits = 0; bits < 8; ++bits) {
+						vec<float>	point	= corner(box, bits);
+						hFile	<< "v " << point.x << ' ' << point.y << ' ' << point.z << '\n';
+					}
+				}
+				for(size_t b = 0; b < boxes.size(); ++b)
+					for(const int* face : faces)
+						hFile	<< "f " << (b * 8 + face[0] + 1) << ' ' << (b * 8 + face[1] + 1)
+								<< ' ' << (b * 8 + face[2] + 1) << '\n';
+			} else {
+				hFile	<< "{\n\t\"count\": " << boxes.size() << ",\n\t\"boxes\": [";
+				for(size_t b = 0; b < boxes.size(); ++b) {
+					vec<float>	low		= corner(boxes[b], 0);
+					vec<float>	high	= corner(boxes[b], 7);
+					hFile	<< (b > 0? ",\n\t\t": "\n\t\t") << "{\"min\": [" << low.x << ", " << low.y << ", " << low.z
+							<< "], \"max\": [" << high.x << ", " << high.y << ", " << high.z << "]}";
+				}
+				hFile	<< "\n\t]\n}\n";
+			}
+			hFile.close();
+			return not hFile.fail();
+		}
+};
+
+#endif
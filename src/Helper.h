@@ -6,6 +6,7 @@
 #include <vector>
 
 #include <cstdio>
+#include <cstdint>
 
 #include <dirent.h>
 #include <errno.h>
@@ -16,6 +17,7 @@
 #ifdef __unix__
 	#include <linux/limits.h>
 	#include <libgen.h>
+	#include <unistd.h>
 #else
 	#include "windows.h"
 	#undef small
@@ -28,7 +30,18 @@ class Helper {
 		static string GetAbsolutePath(const char* anyPath) {
 #ifdef __unix__
 			char	pathBuffer[PATH_MAX];
-			realpath(anyPath, pathBuffer);
+			if(realpath(anyPath, pathBuffer) == nullptr) {
+				//Not existing (yet) file, resolve only its directory
+				string	path	= anyPath;
+				size_t	slash	= path.find_last_of('/');
+				string	dir		= slash == string::npos? ".": path.substr(0, slash);
+				if(slash == 0)
+					dir	= "/";
+				if(realpath(dir.c_str(), pathBuffer) == nullptr)
+					return path;
+				string	ret	= pathBuffer;
+				return (ret == "/"? "": ret) + "/" + path.substr(slash + 1);
+			}
 #else
 			char	pathBuffer[MAX_PATH];
 			GetFullPathNameA(
@@ -72,6 +85,36 @@ class Helper {
 				return false;
 			return bool(info.st_mode & S_IFDIR);
 		}
+		//Size in bytes, 0 when it cannot be read
+		static size_t FileSize(string path) {
+			struct stat info;
+			if(stat(path.c_str(), &info) not_eq 0)
+				return 0;
+			return size_t(info.st_size);
+		}
+		//Hardlinks copy to file (replacing old one), copies content when link is not possible
+		static bool LinkOrCopy(string from, string to) {
+			remove(to.c_str());
+#ifdef __unix__
+			if(link(from.c_str(), to.c_str()) == 0)
+				return true;
+#endif
+			FILE*	source	= fopen(from.c_str(), "rb");
+			if(source == nullptr)
+				return false;
+			FILE*	target	= fopen(to.c_str(), "wb");
+			if(target == nullptr) {
+				fclose(source);
+				return false;
+			}
+			char	buffer[65536];
+			size_t	bytes	= 0;
+			bool	good	= true;
+			while(good and (bytes = fread(buffer, 1, sizeof(buffer), source)) > 0)
+				good	= fwrite(buffer, 1, bytes, target) == bytes;
+			fclose(source);
+			return fclose(target) == 0 and good;
+		}
 		static bool IsFile(string path) {
 			FILE* handle = fopen(path.c_str(), "r");
 			if(handle == nullptr)
@@ -107,6 +150,51 @@ class Helper {
 			return copy;
 		}
 
+		//Contents of JSON string: quote, backslash and control characters escaped
+		static string EscapeJSON(const string& text) {
+			string	escaped;
+			for(char c : text) {
+				if(c == '"' or c == '\\') {
+					escaped	+= '\\';
+					escaped	+= c;
+				} else if(static_cast<unsigned char>(c) < 0x20) {
+					char	code[8];
+					snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned char>(c));
+					escaped	+= code;
+				} else
+					escaped	+= c;
+			}
+			return escaped;
+		}
+
+		//CSV field, quoted (inner quotes doubled) when it holds separator, quote or line break
+		static string EscapeCSV(const string& text) {
+			if(text.find_first_of(",\"\r\n") == string::npos)
+				return text;
+			string	quoted	= "\"";
+			for(char c : text) {
+				if(c == '"')
+					quoted	+= '"';
+				quoted	+= c;
+			}
+			return quoted + '"';
+		}
+
+		//FNV-1a, same value on every machine and run (unlike std::hash)
+		static uint64_t StableHash(const string& text) {
+			uint64_t	hash	= 0xCBF29CE484222325ull;
+			for(char c : text)
+				hash	= (hash ^ static_cast<unsigned char>(c)) * 0x100000001B3ull;
+			return hash;
+		}
+
+		//Finalizer of splitmix64, spreads every input bit over whole result
+		static uint64_t MixHash(uint64_t x) {
+			x	= (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+			x	= (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+			return x ^ (x >> 31);
+		}
+
 		static string ToLower(string input) {
 			string ret	= input;
 			transform(input.begin(), input.end(), ret.begin(), 
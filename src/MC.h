@@ -4,12 +4,20 @@
 #include <string>
 #include <fstream>
 #include <vector>
+#include <memory>
 #include <algorithm>
 #include <map>
 #include <cstring>
 #include <cmath>
+#include <sstream>
+#include <iomanip>
+#include <climits>
 
 #include "VOX.h"
+#include "PNG.h"
+#include "Shell.h"
+#include "Meshopt.h"
+#include "Pipeline.h"
 
 typedef vec<int>	triangle;
 typedef vec<int>	coord;
@@ -17,240 +25,611 @@ typedef vec<float>	vertex;
 
 using std::ofstream;
 
+//Per case data derived from triangulation table at compile time
+struct MarchingCubeCases {
+	uchar	triangles[254]	= {};	//Number of triangles in case
+};
+
+template<size_t N>
+constexpr MarchingCubeCases BuildMarchingCubeCases(const int (&triangulation)[N][16]) {
+	MarchingCubeCases	cases;
+	for(size_t c = 0; c < N; ++c) {
+		int i = 0;
+		while(i < 16 and triangulation[c][i] not_eq -1)
+			++i;
+		cases.triangles[c]	= i / 3;
+	}
+	return cases;
+}
+
 class MarchingCubeModel {
 	private:
 		std::vector<vertex>		vertices;
 		std::vector<int>		indices;
 		std::vector<uchar>		colors;
+		vec<uchar>				palette[256];
+		VOX::Material			materials[256];
+
+		//Normal stream of last GenerateNormals, indexed per corner like colors
+		std::vector<vertex>		normals;
+		std::vector<int>		normalIndices;
+
+		//Meshed region: lattice shift of cropped grid and its cubes to emit (inclusive)
+		coord					origin;
+		coord					windowMin;
+		coord					windowMax;
+
+		float					latticeStep	= 0.0f;	//Spacing all vertices lie on (MC), 0 when arbitrary
+
+		//Global numbers of first vertex/corner held in buffers (streaming), 0 otherwise
+		size_t					vertexShift	= 0;
+		size_t					cornerShift	= 0;
 
 	public:
 		string		name = "Model";
 		vec<float>	offset;
 
+		string		materialLib		= "material.mtl";
+		bool		materialEntries	= false;	//materialLib has MaterialLibrary entries, otherwise OBJ uses "palette" only
+		bool		perVertexColors	= false;	//OBJ only, PLY/GLB always have them
+		bool		quantize		= false;	//GLB only, 16 bit positions + 8 bit normals
+		bool		compress		= false;	//GLB only, meshopt compressed buffers (implies quantize)
+
+		enum NormalMode {
+			AUTO_NORMALS,	//Format default: OBJ flat, quantized GLB smooth, others none
+			NO_NORMALS,
+			FLAT_NORMALS,
+			SMOOTH_NORMALS
+		};
+		NormalMode	normalMode		= AUTO_NORMALS;
+		float		creaseAngle		= 180.0f;	//Degrees, smooth normals only
+
+		static constexpr size_t	slabSize	= 1 << 18;	//Triangles per StreamOBJ slab
+
+		ObjectPool<VOX>*	gridPool	= nullptr;	//Optional source of reusable scratch grids
+		VOX::Layout			gridLayout	= VOX::LINEAR;	//Memory order of upscaled grids
+		AxisTransform		transform;					//Applied to source before meshing (flips)
+
 		MarchingCubeModel()
 			: vertices(), indices(), colors(), offset(0, 0, 0)
 		{}
 		~MarchingCubeModel() {};
 
+		//Exact size of output mesh
+		struct MeshStats {
+			size_t	vertices	= 0;
+			size_t	triangles	= 0;
+
+			//Bytes of in-memory buffers (positions, indices, colors)
+			size_t Bytes() const {
+				return vertices * sizeof(vertex) + triangles * 3 * (sizeof(int) + sizeof(uchar));
+			}
+		};
+
+		//Bytes held by mesh buffers (capacity, pooled models keep it)
+		size_t Footprint() const {
+			return	(vertices.capacity() + normals.capacity()) * sizeof(vertex)
+				+	(indices.capacity() + normalIndices.capacity()) * sizeof(int)
+				+	colors.capacity();
+		}
+
 		void LoadVoxels(VOX& vox, float scale = 0.03125f, float upscale = 3.0f) {
-			//Temporal
-			int			ID		= 0;
-			vec<int>	pos(
-				vox.SizeX() * upscale, vox.SizeZ() * upscale, vox.SizeY() * upscale
-			);
+			LoadVoxelsTile(vox, coord(0, 0, 0), coord(INT_MAX, INT_MAX, INT_MAX), scale, upscale);
+		}
 
-			//Space allocation
-			scale		/= upscale;
-#ifdef __unix__
-			VOX*		vox1	= nullptr;
-			VOX*		vox2	= nullptr;
-			#pragma omp parallel sections
-			{
-				#pragma omp section
-				{
-					vox1 = new VOX(pos);
-				}
-				#pragma omp section
-				{
-					vox2 = new VOX(pos);
-				}
+		/*
+			Meshes only source voxels tileMin..tileMax (exclusive) of Unity
+			oriented grid (X, Z, Y of VOX, see TileGrid). Two voxels around
+			tile are upscaled with it so border cubes see their real
+			neighbourhood, and vertices are placed in whole model space.
+			Tiles of one model therefore share border vertices bit for bit
+			and every cube is emitted by exactly one tile, no cracks.
+			Integer upscale only (fractional one does not align tiles).
+		*/
+		void LoadVoxelsTile(VOX& vox, coord tileMin, coord tileMax, float scale = 0.03125f, float upscale = 3.0f) {
+			std::unique_ptr<VOX>	vox1;
+			std::unique_ptr<VOX>	vox2;
+			coord	full		= TileGrid(vox);
+			coord	cropMin;
+			coord	cropMax;
+			for(int i = 0; i < 3; ++i) {
+				tileMax.raw[i]	= std::min(tileMax.raw[i], full.raw[i]);
+				cropMin.raw[i]	= std::max(0, tileMin.raw[i] - 2);
+				cropMax.raw[i]	= std::min(full.raw[i], tileMax.raw[i] + 2);
 			}
-			VOX&		newVox		= *vox1;
-			VOX&		finalVox	= *vox2;
-#else
-			VOX			newVox(pos);
-			VOX			finalVox(pos);
-#endif
-			vertex		halfSize	= newVox.Size() * 0.5f;
+			VOX&	finalVox	= PrepareGrid(vox, upscale, vox1, vox2, cropMin, cropMax);
+
+			//Center of whole model, not of tile
+			coord	fullSize(full.x * upscale, full.y * upscale, full.z * upscale);
+			vertex	halfSize	= fullSize * 0.5f;
+			vertex	center(halfSize.x, upscale, halfSize.z + upscale);
+
+			//Cubes span -1..size, outer ones belong to first/last tile
+			bool	whole		= true;
+			for(int i = 0; i < 3; ++i) {
+				origin.raw[i]		= cropMin.raw[i] * upscale;
+				windowMin.raw[i]	= tileMin.raw[i] <= 0? -1: tileMin.raw[i] * upscale - origin.raw[i];
+				windowMax.raw[i]	= tileMax.raw[i] >= full.raw[i]?
+					finalVox.Size().raw[i]: tileMax.raw[i] * upscale - 1 - origin.raw[i];
+				whole	= whole and tileMin.raw[i] <= 0 and tileMax.raw[i] >= full.raw[i];
+			}
+
+			CopyPalette(vox);
+
+			//Counting pre-pass, then every layer writes to its own precomputed range
+			std::vector<MeshStats>	layers;
+			MeshStats				total	= CountMarchingCubes(finalVox, layers);
 
-			//Palette copy
+			vertices.resize(total.vertices);
+			indices.resize(total.triangles * 3);
+			colors.resize(total.triangles * 3);
+
+			scale	/= upscale;
+			int		layerCount	= layers.size();
+			//Vertices sit on cube corners or edge midpoints
+			latticeStep	= scale * 0.5f;
 #ifdef __unix__
-			#pragma omp parallel for
+			#pragma omp parallel
 #endif
-			for(int i = 0; i < 256; ++i) {
-				finalVox.AccessPalleteColor(i).Set(
-					vox.AccessPalleteColor(i)
-				);
-			}
-
-			//Scalling 3x
+			{
+				LayerEdges	edges(finalVox.SizeX(), finalVox.SizeY());
 #ifdef __unix__
-			//OpenMP does not support refering to fields as initalizers etc...
-			#pragma omp parallel for
+				#pragma omp for schedule(dynamic)
 #endif
-			for(int z = 0; z < vox.SizeZ(); ++z) {
-				for(int y = 0; y < vox.SizeY(); ++y) {
-					for(int x = 0; x < vox.SizeX(); ++x) {
-						ID = vox.GetVoxelRaw(
-							x, vox.SizeY() - y - 1, z
-						);
-						if(ID > 0) {
-							for(float Z = 0; Z < upscale; ++Z) {
-								for(float Y = 0; Y < upscale; ++Y) {
-									for(float X = 0; X < upscale; ++X) {
-										//Copy voxel with rotation fix (Magica => Unity)
-										newVox.SetVoxelRaw(
-											upscale * x + X,
-											upscale * z + Z,
-											upscale * y + Y,
-											ID
-										);
+				for(int layer = 0; layer < layerCount; ++layer)
+					MeshLayer(finalVox, layers, layer, edges, scale, center);
+			}
+			ReleaseGrids(vox1, vox2);
+
+			//Crossed edges of neighbourhood are numbered too, but only tile cubes use them
+			if(not whole)
+				DropUnusedVertices();
+		}
+
+		//Size of grid tiles are taken from (source voxels, Unity orientation)
+		static coord TileGrid(VOX& vox) {
+			return coord(vox.SizeX(), vox.SizeZ(), vox.SizeY());
+		}
+
+		//Exact mesh size without meshing (upscaling still has to be done)
+		MeshStats Measure(VOX& vox, float upscale = 3.0f) {
+			std::unique_ptr<VOX>	vox1;
+			std::unique_ptr<VOX>	vox2;
+			std::vector<MeshStats>	layers;
+			VOX&	finalVox	= PrepareGrid(vox, upscale, vox1, vox2);
+			origin.Set(0, 0, 0);
+			windowMin.Set(-1, -1, -1);
+			windowMax	= finalVox.Size();
+			MeshStats	total	= CountMarchingCubes(finalVox, layers);
+			ReleaseGrids(vox1, vox2);
+			return total;
+		}
+
+		/*
+			Naive surface nets straight on source resolution grid,
+			no upscaling nor corner removal, one vertex per surface cell.
+			bevel:	0.0 => blocky (vertex in voxel corner)
+					1.0 => full surface nets smoothing (rounded edges)
+		*/
+		void LoadVoxelsSurfaceNets(VOX& vox, float scale = 0.03125f, float upscale = 3.0f, float bevel = 1.0f) {
+			bevel	= std::min(1.0f, std::max(0.0f, bevel));
+			CopyPalette(vox);
+
+			//Buffers sized once by counting pass
+			Clear();
+			Reserve(MeasureSurfaceNets(vox));
+
+			//Grid with flips and Magica => Unity rotation fix, same as upscaled one in LoadVoxels
+			VOX::TransformedView	source(vox, transform.Then(AxisTransform::MagicaToUnity()));
+			vec<int>				dim		= source.Size();
+			auto					sample	= [&](int x, int y, int z) -> uchar {
+				return source.Get(x, y, z);
+			};
+
+			//Output space matching LoadVoxels (centered, same units)
+			vec<int>	upSize(dim.x * upscale, dim.y * upscale, dim.z * upscale);
+			vertex		center(upSize.x * 0.5f + upscale, upscale, upSize.z * 0.5f);
+			scale		/= upscale;
+			latticeStep	= 0.0f;
+
+			//Cell (x, y, z) spans voxels x..x+1, cells are shifted by one for padding
+			vec<int>			cells(dim.x + 1, dim.y + 1, dim.z + 1);
+			std::vector<int>	cellVertex(cells.x * cells.y * cells.z, -1);
+			auto				cellIndex	= [&](int x, int y, int z) -> int {
+				return (x + 1) + cells.x * ((y + 1) + cells.y * (z + 1));
+			};
+
+			//Vertices
+			for(int z = -1; z < dim.z; ++z) {
+				for(int y = -1; y < dim.y; ++y) {
+					for(int x = -1; x < dim.x; ++x) {
+						uchar	mask	= 0;
+						for(int i = 0; i < 8; ++i) {
+							if(sample(x + (i & 1), y + ((i >> 1) & 1), z + ((i >> 2) & 1)) > 0)
+								mask |= 1 << i;
+						}
+						if(mask == 0 or mask == 255)
+							continue;
+
+						//Mean of crossing edge midpoints & half cell shrink towards solid side
+						//(LoadVoxels erodes one upscaled layer and MC adds half of it back)
+						vertex	mean;
+						vertex	shrink;
+						int		crossings	= 0;
+						for(int axis = 0; axis < 3; ++axis) {
+							int	bit		= 1 << axis;
+							int	lower	= 0;
+							int	upper	= 0;
+							for(int i = 0; i < 8; ++i) {
+								if((i & bit) == 0) {
+									bool	a	= mask & (1 << i);
+									bool	b	= mask & (1 << (i | bit));
+									lower	+= a;
+									upper	+= b;
+									if(a not_eq b) {
+										for(int k = 0; k < 3; ++k) {
+											if(k not_eq axis)
+												mean.raw[k]	+= (i & (1 << k))? 0.5f: -0.5f;
+										}
+										++crossings;
 									}
 								}
 							}
-						}//Weeeeee, pyramid of shame
+							shrink.raw[axis]	= lower > upper? -0.5f: (lower < upper? 0.5f: 0.0f);
+						}
+
+						//Cell center is shared corner of its 8 voxels
+						vertex	grid(
+							(x + 1 + bevel * mean.x / crossings) * upscale + shrink.x,
+							(y + 1 + bevel * mean.y / crossings) * upscale + shrink.y,
+							(z + 1 + bevel * mean.z / crossings) * upscale + shrink.z
+						);
+						cellVertex[cellIndex(x, y, z)]	= vertices.size();
+						vertices.emplace_back(
+							(grid.x + offset.x - center.x) * scale,
+							(grid.y + offset.y - center.y) * scale,
+							(grid.z + offset.z - center.z) * scale
+						);
 					}
 				}
 			}
 
-			//Removing corner/edge voxels
-#ifdef __unix__
-			#pragma omp parallel for
-#endif
-			for(int z = 0; z < newVox.SizeZ(); ++z) {
-				for(int y = 0; y < newVox.SizeY(); ++y) {
-					for(int x = 0; x < newVox.SizeX(); ++x) {
-						ID = 0;
-
-						//Corners/Edge ignoring
-						for(int i = 0; i < 6; ++i)
-							if(newVox.GetVoxel(
-								colorGrab[i].x + x,
-								colorGrab[i].y + y,
-								colorGrab[i].z + z
-							) > 0)
-								++ID;
-						
-						if(ID >= 6)
-							finalVox.SetVoxel(x, y, z, newVox.GetVoxel(x, y, z));
+			//Quads, one for every solid/empty voxel pair
+			for(int z = -1; z < dim.z; ++z) {
+				for(int y = -1; y < dim.y; ++y) {
+					for(int x = -1; x < dim.x; ++x) {
+						uchar	ID	= sample(x, y, z);
+						for(int axis = 0; axis < 3; ++axis) {
+							coord	next(x, y, z);
+							++next.raw[axis];
+
+							uchar	nextID	= sample(next.x, next.y, next.z);
+							if((ID > 0) == (nextID > 0))
+								continue;
+
+							//Cells around shared face, in (u, v) plane where u x v = axis
+							int		u		= (axis + 1) % 3;
+							int		v		= (axis + 2) % 3;
+							int		quad[4];
+							for(int i = 0; i < 4; ++i) {
+								coord	cell(x, y, z);
+								cell.raw[u]	-= (i == 0 or i == 3)? 1: 0;
+								cell.raw[v]	-= (i < 2)? 1: 0;
+								quad[i]	= cellVertex[cellIndex(cell.x, cell.y, cell.z)];
+							}
+
+							//SaveOBJ reverses winding, solid on upper side flips normal
+							if(ID > 0)
+								std::swap(quad[1], quad[3]);
+
+							indices.insert(indices.end(), {
+								quad[0], quad[1], quad[2],
+								quad[0], quad[2], quad[3]
+							});
+							colors.insert(colors.end(), 6, (ID > 0? ID: nextID) - 1);
+						}
 					}
 				}
 			}
+		}
 
-			//MC
-			for(int z = -1; z <= finalVox.SizeZ(); ++z) {
-				for(int y = -1; y <= finalVox.SizeY(); ++y) {
-					for(int x = -1; x <= finalVox.SizeX(); ++x) {
-						pos.Set(x, y, z);
-						uchar		bits	= 0;
+		//Drops mesh but keeps buffers allocated for next model
+		void Clear() {
+			vertices.clear();
+			indices.clear();
+			colors.clear();
+		}
 
-						for(size_t i = 0; i < 27; ++i) {
-							ID = finalVox.GetVoxel(pos + corner[i]);
-							if(ID > 0) {
-								bits |= cornerBits[i];
-							}
-						}
+		void Reserve(const MeshStats& stats) {
+			vertices.reserve(stats.vertices);
+			indices.reserve(stats.triangles * 3);
+			colors.reserve(stats.triangles * 3);
+		}
 
-						ID = finalVox.GetVoxel(pos);
+		MeshStats Stats() const {
+			MeshStats	stats;
+			stats.vertices	= vertices.size();
+			stats.triangles	= indices.size() / 3;
+			return stats;
+		}
 
-						if(bits == 0 or bits == 255)
-							continue;
+		//Axis aligned bounds of vertices, false for empty mesh
+		bool Bounds(vertex& minimum, vertex& maximum) const {
+			minimum.Set( 1e30f,  1e30f,  1e30f);
+			maximum.Set(-1e30f, -1e30f, -1e30f);
+			for(const vertex& vert : vertices) {
+				for(int k = 0; k < 3; ++k) {
+					minimum.raw[k]	= std::min(minimum.raw[k], vert.raw[k]);
+					maximum.raw[k]	= std::max(maximum.raw[k], vert.raw[k]);
+				}
+			}
+			return not vertices.empty();
+		}
 
-						bits -= 1;
-
-						int triangulationVert	= 0;
-						for(int i = 0; i < 15; ++i) {
-							int edge = triangulation[bits][triangulationVert];
-							
-							if(edge == -1)
-								break;
-
-							auto	_v1 = pos + edgeOffset[edge][0];
-							auto	_v2 = pos + edgeOffset[edge][1];
-
-							vertex	v1(
-								_v1.x + offset.x, _v1.y + offset.y, _v1.z + offset.z
-							);
-							vertex	v2(
-								_v2.x + offset.x, _v2.y + offset.y, _v2.z + offset.z
-							);
-							vertex	vFinal(
-								((v1 + v2) * 0.5f - vec<float>(
-									halfSize.x, upscale, halfSize.z + upscale
-								)) * scale
-							);
-
-							auto it = find(vertices.begin(), vertices.end(), vFinal);
-							if(it == vertices.end()) {
-								indices.push_back(vertices.size());
-								vertices.push_back(vFinal);
-							} else {
-								indices.push_back(distance(vertices.begin(), it));
-							}
+		//Simulated FIFO post-transform cache misses per triangle (ACMR)
+		float CacheMissRatio(int cacheSize = 16) const {
+			if(indices.empty())
+				return 0.0f;
+
+			//Miss number vertex entered cache with, 0 => never loaded
+			std::vector<size_t>	loaded(vertices.size(), 0);
+			size_t				misses	= 0;
+			for(int index : indices) {
+				if(loaded[index] == 0 or misses - loaded[index] >= size_t(cacheSize))
+					loaded[index]	= ++misses;
+			}
+			return float(misses) / (indices.size() / 3);
+		}
 
-							++triangulationVert;
-						}
+		struct CacheStats {
+			float	before	= 0.0f;
+			float	after	= 0.0f;
+		};
 
-						for(size_t i = 0; i < sizeof(colorGrab); ++i) {
-							ID = finalVox.GetVoxel(colorGrab[i] + pos);
-							if(ID not_eq 0) {
-								for(int j = 0; j < triangulationVert; ++j)
-									colors.push_back(ID - 1);
-								break;
-							}
-						}
+		/*
+			Reorders triangles for post-transform vertex cache (Tipsify,
+			Sander et al. 2007): fans around vertex that stays longest in
+			FIFO cache, dead ends resume from recently emitted vertices.
+			Vertices are then renumbered in first use order, so vertex
+			fetches walk memory forward. Colors move with their triangles.
+		*/
+		CacheStats OptimizeVertexOrder(int cacheSize = 16) {
+			CacheStats	stats;
+			stats.before	= CacheMissRatio(cacheSize);
+
+			int		vertexCount	= vertices.size();
+			size_t	triangles	= indices.size() / 3;
+
+			//Vertex => triangles using it (offsets + flat list)
+			std::vector<int>	first(vertexCount + 1, 0);
+			for(int index : indices)
+				++first[index + 1];
+			for(int v = 0; v < vertexCount; ++v)
+				first[v + 1]	+= first[v];
+			std::vector<int>	adjacent(indices.size());
+			std::vector<int>	fill(first.begin(), first.end() - 1);
+			for(size_t i = 0; i < indices.size(); ++i)
+				adjacent[fill[indices[i]]++]	= i / 3;
+
+			std::vector<int>	live(vertexCount);	//Triangles not emitted yet
+			for(int v = 0; v < vertexCount; ++v)
+				live[v]	= first[v + 1] - first[v];
+
+			std::vector<int>	cached(vertexCount, 0);	//Time vertex entered cache
+			std::vector<uchar>	emitted(triangles, 0);
+			std::vector<int>	order;
+			std::vector<int>	deadEnds;
+			std::vector<int>	candidates;
+			order.reserve(triangles);
+
+			int		time	= cacheSize + 1;
+			int		cursor	= 0;
+			int		fan		= 0;
+			while(cursor < vertexCount and live[cursor] == 0)
+				++cursor;
+			fan	= cursor < vertexCount? cursor: -1;
+
+			while(fan >= 0) {
+				candidates.clear();
+				for(int k = first[fan]; k < first[fan + 1]; ++k) {
+					int	t	= adjacent[k];
+					if(emitted[t])
+						continue;
+					emitted[t]	= 1;
+					order.push_back(t);
+					for(int c = 0; c < 3; ++c) {
+						int	v	= indices[t * 3 + c];
+						deadEnds.push_back(v);
+						candidates.push_back(v);
+						--live[v];
+						if(time - cached[v] > cacheSize)
+							cached[v]	= time++;
+					}
+				}
+
+				//Candidate that stays in cache for its whole fan, oldest first
+				fan		= -1;
+				int		best	= -1;
+				for(int v : candidates) {
+					if(live[v] == 0)
+						continue;
+					int	priority	= time - cached[v] + 2 * live[v] <= cacheSize? time - cached[v]: 0;
+					if(priority > best) {
+						best	= priority;
+						fan		= v;
+					}
+				}
+
+				//Dead end: recently used vertex, then next one in input order
+				while(fan < 0 and not deadEnds.empty()) {
+					int	v	= deadEnds.back();
+					deadEnds.pop_back();
+					if(live[v] > 0)
+						fan	= v;
+				}
+				while(fan < 0 and cursor < vertexCount) {
+					if(live[cursor] > 0)
+						fan	= cursor;
+					else
+						++cursor;
+				}
+			}
+
+			//New triangle order, vertices numbered by first use (unused ones last)
+			std::vector<int>	remap(vertexCount, -1);
+			std::vector<int>	newIndices(indices.size());
+			std::vector<uchar>	newColors(colors.size());
+			int					used	= 0;
+			for(size_t i = 0; i < triangles; ++i) {
+				for(int c = 0; c < 3; ++c) {
+					int	v	= indices[order[i] * 3 + c];
+					if(remap[v] < 0)
+						remap[v]	= used++;
+					newIndices[i * 3 + c]	= remap[v];
+					newColors[i * 3 + c]	= colors[order[i] * 3 + c];
+				}
+			}
+			for(int v = 0; v < vertexCount; ++v)
+				if(remap[v] < 0)
+					remap[v]	= used++;
+
+			std::vector<vertex>	newVertices(vertexCount);
+			for(int v = 0; v < vertexCount; ++v)
+				newVertices[remap[v]]	= vertices[v];
+
+			vertices.swap(newVertices);
+			indices.swap(newIndices);
+			colors.swap(newColors);
+
+			stats.after	= CacheMissRatio(cacheSize);
+			return stats;
+		}
+
+		//Exact surface nets mesh size: mixed cells and 2 triangles per exposed face
+		static MeshStats MeasureSurfaceNets(VOX& vox) {
+			MeshStats	stats;
+			size_t		cells	= 0;
+#ifdef __unix__
+			#pragma omp parallel for reduction(+:cells)
+#endif
+			for(int z = -1; z < vox.SizeZ(); ++z) {
+				for(int y = -1; y < vox.SizeY(); ++y) {
+					for(int x = -1; x < vox.SizeX(); ++x) {
+						int	solid	= 0;
+						for(int i = 0; i < 8; ++i)
+							solid	+= vox.GetVoxel(x + (i & 1), y + ((i >> 1) & 1), z + ((i >> 2) & 1)) > 0;
+						cells	+= solid > 0 and solid < 8;
 					}
 				}
 			}
+			stats.vertices	= cells;
+			stats.triangles	= EstimateTriangles(vox, 1.0f);
+			return stats;
+		}
+
+		/*
+			Occupancy based output size guess: every exposed voxel face turns
+			into upscale^2 quads of upscaled grid, each made of 2 triangles.
+			Slight overestimate for MC due to eroded edges/corners, exact for
+			surface nets (upscale 1).
+		*/
+		static size_t EstimateTriangles(VOX& vox, float upscale) {
+			size_t	exposed	= 0;
 #ifdef __unix__
-			delete vox1;
-			delete vox2;
+			#pragma omp parallel for reduction(+:exposed)
 #endif
+			for(int z = 0; z < vox.SizeZ(); ++z) {
+				for(int y = 0; y < vox.SizeY(); ++y) {
+					for(int x = 0; x < vox.SizeX(); ++x) {
+						VOX::Cursor	voxel	= vox.At(x, y, z);
+						if(voxel.Get() == 0)
+							continue;
+						exposed	+= (voxel.Neighbour(-1, 0, 0) == 0) + (voxel.Neighbour(1, 0, 0) == 0)
+								+  (voxel.Neighbour(0, -1, 0) == 0) + (voxel.Neighbour(0, 1, 0) == 0)
+								+  (voxel.Neighbour(0, 0, -1) == 0) + (voxel.Neighbour(0, 0, 1) == 0);
+					}
+				}
+			}
+			return size_t(exposed * upscale * upscale * 2);
+		}
+
+		/*
+			Peak memory guess of conversion from header counts only (see
+			VOX::Inspect): source grid, upscaled grid(s) with shell mask
+			and mesh with writer scratch (normal generation). Exposed faces
+			are at most 6 per voxel and at most both sides of bounding box
+			surface, so hollow and sparse models are close while solid
+			ones are overestimated. With slabTriangles mesh is that of
+			StreamOBJ, two slabs instead of whole model.
+		*/
+		static size_t EstimatePeakBytes(vec<int> size, size_t voxels, float upscale, size_t slabTriangles = 0) {
+			size_t	cells	= size_t(size.x) * size.y * size.z;
+			size_t	scaled	= size_t(size.x * upscale) * size_t(size.y * upscale) * size_t(size.z * upscale);
+			int		factor	= upscale == floor(upscale)? int(upscale): 0;
+			size_t	grids	= cells + (factor >= 1 and factor <= 4? scaled + cells / 4: 2 * scaled);
+
+			size_t		box		= 2 * (size_t(size.x) * size.y + size_t(size.y) * size.z + size_t(size.z) * size.x);
+			MeshStats	mesh;
+			mesh.triangles	= size_t(std::min(6 * voxels, 2 * box) * upscale * upscale * 2);
+			if(slabTriangles > 0) {
+				//Slab ends after layer that crossed slabTriangles, layer is at most 2 sides of biggest face
+				size_t	face	= std::max({
+					size_t(size.x) * size.y, size_t(size.y) * size.z, size_t(size.z) * size.x
+				});
+				size_t	layer	= size_t(face * upscale * upscale * 4);
+				mesh.triangles	= std::min(mesh.triangles, 2 * (slabTriangles + layer));
+			}
+			mesh.vertices	= mesh.triangles / 2;
+			return grids + mesh.Bytes() + mesh.triangles * (2 * sizeof(vertex) + 3 * sizeof(int));
+		}
+
+		//Picks writer by extension (.obj, .ply, .glb)
+		bool Save(string path) {
+			string	ext	= Helper::ToLower(path.substr(path.find_last_of('.') + 1));
+			if(ext == "ply")
+				return SavePLY(path);
+			if(ext == "glb")
+				return SaveGLB(path);
+			return SaveOBJ(path);
 		}
 
-		void SaveOBJ(string path) {
+		bool SaveOBJ(string path) {
 			ofstream hFile(path, std::ios::trunc bitor std::ios::out);
+			if(hFile.fail())
+				return false;
 
+			//Faces grouped by material, first one is set in header
+			std::vector<MaterialRange>	ranges	= SortByMaterial();
 			hFile
 				<< "g " << (name == ""? "Model": name) << '\n'
-				<< "mtllib material.mtl\n"
-				<< "usemtl palette\n"
+				<< "mtllib " << materialLib << "\n"
+				<< "usemtl " << (ranges.empty() or not materialEntries? "palette": MaterialName(ranges[0].palette)) << "\n"
 			<< endl;
 
-			//Vertex ID/Normal map
-			std::vector<vec<float>>	normals;
-			std::map<int, int>		normalMap;
-
-			for(size_t i = 2; i < indices.size(); i += 3) {
-				auto&	A	= vertices[indices[i - 2]];
-				auto&	B	= vertices[indices[i - 1]];
-				auto&	C	= vertices[indices[i]];
-
-				auto		AB		= B - A;
-				auto		AC		= C - A;
-				vec<float>	normal	= AB.NormalizedCross(AC);
-
-				//Naive "compression" due to doubles removal
-				normal.Set(
-					round(normal.x * 1000.0) / 1000.0,
-					round(normal.y * 1000.0) / 1000.0,
-					round(normal.z * 1000.0) / 1000.0
-				);
-				//float/double bit sign problem
-				normal.Set(
-					normal.x == -0.0? 0.0: normal.x,
-					normal.y == -0.0? 0.0: normal.y,
-					normal.z == -0.0? 0.0: normal.z
-				);
-
-				auto it = find(normals.begin(), normals.end(), normal);
-				if(it not_eq normals.end()) {
-					normalMap[i]	= distance(normals.begin(), it) + 1;
-				} else {
-					normals.push_back(normal);
-					normalMap[i] 	= normals.size() + 1;
-
-					hFile	<< "vn"
-							<< ' ' << normal.x << ' ' << normal.y << ' ' << normal.z
-					<< endl;
-				}
+			//Optional per vertex colors, vertices shared by different colors are split
+			std::vector<vertex>		colorVertices;
+			std::vector<vec<uchar>>	vertexColors;
+			std::vector<int>		colorIndices;
+			if(perVertexColors)
+				BuildColoredVertices(colorVertices, vertexColors, colorIndices);
+
+			const std::vector<vertex>&	outVertices	= perVertexColors? colorVertices: vertices;
+			const std::vector<int>&		outIndices	= perVertexColors? colorIndices: indices;
+
+			GenerateNormals(normalMode == AUTO_NORMALS? FLAT_NORMALS: normalMode);
+			for(const vertex& normal : normals) {
+				//+0.0f turns -0 into 0
+				hFile	<< "vn "
+						<< (normal.x + 0.0f) << ' ' << (normal.y + 0.0f) << ' ' << (normal.z + 0.0f) << '\n';
 			}
 
-			std::vector<int>		uniqueColors;
+			//Palette index => texture coordinate index, flat table instead of searching
+			int		texCoord[256];
+			int		texCoords	= 0;
+			std::fill(texCoord, texCoord + 256, 0);
 			for(size_t i = 0; i < colors.size(); ++i) {
-				auto it = find(uniqueColors.begin(), uniqueColors.end(), colors[i]);
-				if(it == uniqueColors.end()) {
-					uniqueColors.push_back(colors[i]);
+				if(texCoord[colors[i]] == 0) {
+					texCoord[colors[i]]	= ++texCoords;
 
 					hFile	<< "vt "
 							<< ((int(colors[i]) + 1) * texturePixelSize - halfTexturePixelSize)
@@ -258,36 +637,1343 @@ class MarchingCubeModel {
 				}
 			}
 
-			for(vertex& vert : vertices) {
-				hFile << "v " << vert.x << ' ' << vert.y << ' ' << vert.z << '\n';
+			for(size_t i = 0; i < outVertices.size(); ++i) {
+				const vertex&	vert	= outVertices[i];
+				hFile << "v " << vert.x << ' ' << vert.y << ' ' << vert.z;
+				if(perVertexColors) {
+					//Non standard (but common) "v x y z r g b" extension
+					const vec<uchar>&	color	= vertexColors[i];
+					hFile	<< ' ' << color.r / 255.0f
+							<< ' ' << color.g / 255.0f
+							<< ' ' << color.b / 255.0f;
+				}
+				hFile << '\n';
+			}
+
+			//Corners 0, 2, 1 (output winding), normals are optional
+			for(size_t r = 0; r < ranges.size(); ++r) {
+				if(r > 0 and materialEntries)
+					hFile << "usemtl " << MaterialName(ranges[r].palette) << '\n';
+				for(size_t i = ranges[r].begin * 3; i < ranges[r].end * 3; i += 3) {
+					hFile << 'f';
+					for(int corner : {0, 2, 1}) {
+						hFile << ' ' << (outIndices[i + corner] + 1) << '/' << texCoord[colors[i + corner]];
+						if(not normalIndices.empty())
+							hFile << '/' << (normalIndices[i + corner] + 1);
+					}
+					hFile << '\n';
+				}
 			}
+			hFile << '\n';
+
+			hFile.flush();
+			hFile.close();
+			return not hFile.fail();
+		}
 
-			for(size_t i = 0; i < indices.size(); i += 3) {
-				hFile	<< "f "
+		/*
+			Meshes (MC) and writes OBJ in one go with bounded mesh memory.
+			Layers of cubes are cut into slabs of about slabTriangles, slab
+			is meshed in parallel into one of two buffers while writer
+			thread formats the other one. Vertex numbers come from counting
+			pass, faces refer to vertices of written slabs just by number,
+			so only two slabs of mesh exist at once. Lines are those of
+			SaveOBJ (flat or no normals, no vertex colors) with "vt"/"vn"
+			written where first used, material groups follow mesh order.
+		*/
+		bool StreamOBJ(VOX& vox, string path, float scale = 0.03125f, float upscale = 3.0f, size_t slabTriangles = slabSize) {
+			ofstream hFile(path, std::ios::trunc bitor std::ios::out);
+			if(hFile.fail())
+				return false;
+
+			std::unique_ptr<VOX>	vox1;
+			std::unique_ptr<VOX>	vox2;
+			VOX&	finalVox	= PrepareGrid(vox, upscale, vox1, vox2);
+			coord	full		= TileGrid(vox);
+			coord	fullSize(full.x * upscale, full.y * upscale, full.z * upscale);
+			vertex	halfSize	= fullSize * 0.5f;
+			vertex	center(halfSize.x, upscale, halfSize.z + upscale);
+			origin.Set(0, 0, 0);
+			windowMin.Set(-1, -1, -1);
+			windowMax	= finalVox.Size();
+			CopyPalette(vox);
+			Clear();
+
+			std::vector<MeshStats>	layers;
+			MeshStats				total	= CountMarchingCubes(finalVox, layers);
+			int						layerCount	= layers.size();
+			layers.push_back(total);
+			scale	/= upscale;
+			latticeStep	= scale * 0.5f;
+
+			//Slab = first layer, ends where next one starts
+			std::vector<int>	slabs(1, 0);
+			for(int layer = 1; layer < layerCount; ++layer)
+				if(layers[layer].triangles - layers[slabs.back()].triangles >= slabTriangles)
+					slabs.push_back(layer);
+			slabs.push_back(layerCount);
+
+			struct Slab {
+				int						first;
+				int						end;
+				std::vector<vertex>		vertices;
+				std::vector<int>		indices;
+				std::vector<uchar>		colors;
+				std::vector<vertex>		faceNormals;
+			};
+			Slab	buffers[2];
+
+			bool	withNormals	= normalMode not_eq NO_NORMALS;
+			int		group[256];
+			std::vector<int>	firstPalette;
+			MaterialGroups(group, firstPalette);
+
+			hFile
+				<< "g " << (name == ""? "Model": name) << '\n'
+				<< "mtllib " << materialLib << "\n"
+				<< "usemtl palette\n"
+			<< endl;
 
-						<< (indices[i + 0] + 1) << "/";
-				auto it = find(uniqueColors.begin(), uniqueColors.end(), colors[i]);
-				hFile	<< (distance(uniqueColors.begin(), it) + 1)
-						<< "/" << normalMap[indices[i + 0]] << " "
+			//Writer state, tables are filled in order of first use like in SaveOBJ
+			int							texCoord[256];
+			int							texCoords	= 0;
+			std::map<long long, int>	shared;
+			int							material	= -1;	//Header "palette"
+			std::fill(texCoord, texCoord + 256, 0);
+			auto	write	= [&](const Slab& slab) {
+				for(const vertex& vert : slab.vertices)
+					hFile << "v " << vert.x << ' ' << vert.y << ' ' << vert.z << '\n';
+
+				for(size_t i = 0; i < slab.indices.size(); i += 3) {
+					uchar	color	= slab.colors[i];
+					if(materialEntries and group[color] not_eq material) {
+						string	next	= MaterialName(firstPalette[group[color]]);
+						if(material >= 0 or next not_eq "palette")
+							hFile << "usemtl " << next << '\n';
+						material	= group[color];
+					}
+					if(texCoord[color] == 0) {
+						texCoord[color]	= ++texCoords;
+						hFile	<< "vt " << ((int(color) + 1) * texturePixelSize - halfTexturePixelSize) << " 0.5\n";
+					}
+					int		normal	= 0;
+					if(withNormals) {
+						const vertex&	unit	= slab.faceNormals[i / 3];
+						auto			it		= shared.emplace(NormalKey(unit), int(shared.size()));
+						normal	= it.first->second + 1;
+						if(it.second) {
+							hFile	<< "vn "
+									<< (unit.x + 0.0f) << ' ' << (unit.y + 0.0f) << ' ' << (unit.z + 0.0f) << '\n';
+						}
+					}
 
-						<< (indices[i + 2] + 1) << "/";
-					 it = find(uniqueColors.begin(), uniqueColors.end(), colors[i + 2]);
-				hFile	<< (distance(uniqueColors.begin(), it) + 1)
-						<< "/" << normalMap[indices[i + 2]] << " "
-	
-						<< (indices[i + 1] + 1) << "/";
-					 it = find(uniqueColors.begin(), uniqueColors.end(), colors[i + 1]);
-				hFile	<< (distance(uniqueColors.begin(), it) + 1)
-						<< "/" << normalMap[indices[i + 1]] << "\n";
+					hFile << 'f';
+					for(int corner : {0, 2, 1}) {
+						hFile << ' ' << (slab.indices[i + corner] + 1) << '/' << texCoord[color];
+						if(withNormals)
+							hFile << '/' << normal;
+					}
+					hFile << '\n';
+				}
+			};
+
+			//Buffer ping-pong: free => mesher fills => ready => writer writes => free
+#ifdef __unix__
+			BoundedQueue<int>	freeBuffers(2);
+			BoundedQueue<int>	readyBuffers(2);
+			freeBuffers.Push(0);
+			freeBuffers.Push(1);
+			std::thread			writer([&]() {
+				int	buffer;
+				while(readyBuffers.Pop(buffer)) {
+					write(buffers[buffer]);
+					freeBuffers.Push(buffer);
+				}
+			});
+#endif
+			for(size_t s = 0; s + 1 < slabs.size(); ++s) {
+				int		buffer	= s % 2;
+#ifdef __unix__
+				freeBuffers.Pop(buffer);
+#endif
+				Slab&	slab	= buffers[buffer];
+				slab.first	= slabs[s];
+				slab.end	= slabs[s + 1];
+				vertexShift	= layers[slab.first].vertices;
+				cornerShift	= layers[slab.first].triangles * 3;
+				vertices.swap(slab.vertices);
+				indices.swap(slab.indices);
+				colors.swap(slab.colors);
+				vertices.resize(layers[slab.end].vertices - vertexShift);
+				indices.resize(layers[slab.end].triangles * 3 - cornerShift);
+				colors.resize(indices.size());
+				slab.faceNormals.resize(withNormals? indices.size() / 3: 0);
+
+#ifdef __unix__
+				#pragma omp parallel
+#endif
+				{
+					LayerEdges	edges(finalVox.SizeX(), finalVox.SizeY());
+#ifdef __unix__
+					#pragma omp for schedule(dynamic)
+#endif
+					for(int layer = slab.first; layer < slab.end; ++layer)
+						MeshLayer(finalVox, layers, layer, edges, scale, center, withNormals? slab.faceNormals.data(): nullptr);
+				}
+
+				vertices.swap(slab.vertices);
+				indices.swap(slab.indices);
+				colors.swap(slab.colors);
+#ifdef __unix__
+				readyBuffers.Push(buffer);
+#else
+				write(slab);
+#endif
 			}
+#ifdef __unix__
+			readyBuffers.Close();
+			writer.join();
+#endif
+			vertexShift	= 0;
+			cornerShift	= 0;
+			ReleaseGrids(vox1, vox2);
+
 			hFile << '\n';
+			hFile.flush();
+			hFile.close();
+			return not hFile.fail();
+		}
+
+		//Binary PLY with per vertex colors (and normals when asked for)
+		bool SavePLY(string path) {
+			ofstream hFile(path, std::ios::trunc bitor std::ios::out bitor std::ios::binary);
+			if(hFile.fail())
+				return false;
+
+			GenerateNormals(normalMode == AUTO_NORMALS? NO_NORMALS: normalMode);
+			bool					withNormals	= not normalIndices.empty();
+			std::vector<vertex>		outVertices;
+			std::vector<vec<uchar>>	outColors;
+			std::vector<int>		outIndices;
+			std::vector<vertex>		outNormals;
+			BuildColoredVertices(outVertices, outColors, outIndices, &outNormals);
+
+			hFile	<< "ply\n"
+					<< "format binary_little_endian 1.0\n"
+					<< "comment " << (name == ""? "Model": name) << '\n'
+					<< "element vertex " << outVertices.size() << '\n'
+					<< "property float x\n"
+					<< "property float y\n"
+					<< "property float z\n"
+					<< (withNormals? "property float nx\nproperty float ny\nproperty float nz\n": "")
+					<< "property uchar red\n"
+					<< "property uchar green\n"
+					<< "property uchar blue\n"
+					<< "property uchar alpha\n"
+					<< "element face " << (outIndices.size() / 3) << '\n'
+					<< "property list uchar int vertex_indices\n"
+					<< "end_header\n";
+
+			for(size_t i = 0; i < outVertices.size(); ++i) {
+				hFile.write(reinterpret_cast<const char*>(outVertices[i].raw), sizeof(float) * 3);
+				if(withNormals)
+					hFile.write(reinterpret_cast<const char*>(outNormals[i].raw), sizeof(float) * 3);
+				hFile.write(reinterpret_cast<const char*>(outColors[i].raw), 4);
+			}
+
+			const uchar	corners	= 3;
+			for(size_t i = 0; i < outIndices.size(); i += 3) {
+				//Same winding as OBJ output
+				int	face[3]	= {outIndices[i], outIndices[i + 2], outIndices[i + 1]};
+				hFile.write(reinterpret_cast<const char*>(&corners), 1);
+				hFile.write(reinterpret_cast<const char*>(face), sizeof(face));
+			}
 
 			hFile.flush();
 			hFile.close();
+			return not hFile.fail();
+		}
+
+		//Binary glTF 2.0 with POSITION + COLOR_0 (+ NORMAL when asked for)
+		bool SaveGLB(string path) {
+			if(quantize or compress)
+				return SaveQuantizedGLB(path);
+
+			ofstream hFile(path, std::ios::trunc bitor std::ios::out bitor std::ios::binary);
+			if(hFile.fail())
+				return false;
+
+			std::vector<MaterialRange>	ranges	= SortByMaterial();
+			bool						plain	= PlainMaterial(ranges);
+			size_t						groups	= plain? 1: ranges.size();
+
+			GenerateNormals(normalMode == AUTO_NORMALS? NO_NORMALS: normalMode);
+			int						withNormals	= normalIndices.empty()? 0: 1;
+			std::vector<vertex>		outVertices;
+			std::vector<vec<uchar>>	outColors;
+			std::vector<int>		outIndices;
+			std::vector<vertex>		outNormals;
+			BuildColoredVertices(outVertices, outColors, outIndices, &outNormals);
+
+			//Binary chunk: positions | normals | colors | indices (all 4 byte aligned)
+			std::vector<char>	bin;
+			auto				append	= [&](const void* data, size_t length) {
+				bin.insert(bin.end(), static_cast<const char*>(data), static_cast<const char*>(data) + length);
+			};
+
+			vertex	minimum( 1e30f,  1e30f,  1e30f);
+			vertex	maximum(-1e30f, -1e30f, -1e30f);
+			for(vertex& vert : outVertices) {
+				append(vert.raw, sizeof(float) * 3);
+				for(int k = 0; k < 3; ++k) {
+					minimum.raw[k]	= std::min(minimum.raw[k], vert.raw[k]);
+					maximum.raw[k]	= std::max(maximum.raw[k], vert.raw[k]);
+				}
+			}
+			size_t	normalOffset	= bin.size();
+			for(vertex& normal : outNormals)
+				append(normal.raw, sizeof(float) * 3);
+			size_t	colorOffset	= bin.size();
+			for(vec<uchar>& color : outColors)
+				append(color.raw, 4);
+
+			size_t	indexOffset	= bin.size();
+			for(size_t i = 0; i < outIndices.size(); i += 3) {
+				//Same winding as OBJ output
+				unsigned int	face[3]	= {
+					unsigned(outIndices[i]), unsigned(outIndices[i + 2]), unsigned(outIndices[i + 1])
+				};
+				append(face, sizeof(face));
+			}
+
+			//Exact float round trip, accessor bounds must match data
+			std::ostringstream	json;
+			json	<< std::setprecision(9)
+					<< "{\"asset\":{\"version\":\"2.0\",\"generator\":\"vox2mc\"},"
+					<< "\"scene\":0,\"scenes\":[{\"nodes\":[0]}],"
+					<< "\"nodes\":[{\"mesh\":0,\"name\":\"" << Helper::EscapeJSON(name == ""? "Model": name) << "\"}],"
+					<< "\"meshes\":[{\"primitives\":[";
+			for(size_t r = 0; r < groups; ++r) {
+				json	<< (r > 0? ",": "") << "{\"attributes\":{\"POSITION\":0,"
+						<< (withNormals? "\"NORMAL\":1,": "") << "\"COLOR_0\":" << (1 + withNormals) << "},"
+						<< "\"indices\":" << (2 + withNormals + r);
+				if(not plain)
+					json	<< ",\"material\":" << r;
+				json	<< ",\"mode\":4}";
+			}
+			json	<< "]}]" << GLTFMaterials(ranges) << ','
+					<< "\"buffers\":[{\"byteLength\":" << bin.size() << "}],"
+					<< "\"bufferViews\":["
+					<< "{\"buffer\":0,\"byteOffset\":0,\"byteLength\":" << normalOffset << ",\"target\":34962},";
+			if(withNormals) {
+				json	<< "{\"buffer\":0,\"byteOffset\":" << normalOffset << ",\"byteLength\":"
+						<< (colorOffset - normalOffset) << ",\"target\":34962},";
+			}
+			json	<< "{\"buffer\":0,\"byteOffset\":" << colorOffset << ",\"byteLength\":"
+						<< (indexOffset - colorOffset) << ",\"target\":34962},"
+					<< "{\"buffer\":0,\"byteOffset\":" << indexOffset << ",\"byteLength\":"
+						<< (bin.size() - indexOffset) << ",\"target\":34963}],"
+					<< "\"accessors\":["
+					<< "{\"bufferView\":0,\"componentType\":5126,\"count\":" << outVertices.size()
+						<< ",\"type\":\"VEC3\",\"min\":[" << minimum.x << ',' << minimum.y << ',' << minimum.z
+						<< "],\"max\":[" << maximum.x << ',' << maximum.y << ',' << maximum.z << "]},";
+			if(withNormals) {
+				json	<< "{\"bufferView\":1,\"componentType\":5126,\"count\":" << outNormals.size()
+						<< ",\"type\":\"VEC3\"},";
+			}
+			json	<< "{\"bufferView\":" << (1 + withNormals) << ",\"componentType\":5121,\"normalized\":true,\"count\":"
+						<< outColors.size() << ",\"type\":\"VEC4\"}";
+			//Indices accessor per material range, all in one view
+			for(size_t r = 0; r < groups; ++r) {
+				json	<< ",{\"bufferView\":" << (2 + withNormals);
+				if(not plain)
+					json	<< ",\"byteOffset\":" << ranges[r].begin * 3 * sizeof(unsigned int);
+				json	<< ",\"componentType\":5125,\"count\":"
+						<< (plain? outIndices.size(): (ranges[r].end - ranges[r].begin) * 3)
+						<< ",\"type\":\"SCALAR\"}";
+			}
+			json	<< "]}";
+			return WriteGLB(hFile, json.str(), bin);
+		}
+
+		/*
+			Binary glTF with KHR_mesh_quantization: POSITION as 16 bit
+			integers restored by node scale/translation (MC vertices keep
+			their exact lattice when it fits), NORMAL as 8 bit. compress
+			stores every buffer view as EXT_meshopt_compression stream and
+			normals go through its octahedral filter.
+		*/
+		bool SaveQuantizedGLB(string path) {
+			ofstream hFile(path, std::ios::trunc bitor std::ios::out bitor std::ios::binary);
+			if(hFile.fail())
+				return false;
+
+			std::vector<MaterialRange>	ranges	= SortByMaterial();
+			bool						plain	= PlainMaterial(ranges);
+			size_t						groups	= plain? 1: ranges.size();
+
+			GenerateNormals(normalMode == AUTO_NORMALS? SMOOTH_NORMALS: normalMode);
+			bool					withNormals	= not normalIndices.empty();
+			std::vector<vertex>		outVertices;
+			std::vector<vec<uchar>>	outColors;
+			std::vector<int>		outIndices;
+			std::vector<vertex>		outNormals;
+			BuildColoredVertices(outVertices, outColors, outIndices, &outNormals);
+			size_t	count	= outVertices.size();
+
+			vertex	minimum(0, 0, 0);
+			vertex	maximum(0, 0, 0);
+			for(size_t i = 0; i < count; ++i) {
+				for(int k = 0; k < 3; ++k) {
+					minimum.raw[k]	= i == 0? outVertices[i].raw[k]: std::min(minimum.raw[k], outVertices[i].raw[k]);
+					maximum.raw[k]	= i == 0? outVertices[i].raw[k]: std::max(maximum.raw[k], outVertices[i].raw[k]);
+				}
+			}
+			float	extent	= std::max(maximum.x - minimum.x, std::max(maximum.y - minimum.y, maximum.z - minimum.z));
+			float	step	= latticeStep;
+			if(step <= 0.0f or extent / step > 65535.0f)
+				step	= extent > 0.0f? extent / 65535.0f: 1.0f;
+
+			//Positions padded to 8 bytes, attribute strides must be multiple of 4
+			std::vector<unsigned short>	positions(count * 4, 0);
+			unsigned short				highest[3]	= {0, 0, 0};
+			for(size_t i = 0; i < count; ++i) {
+				for(int k = 0; k < 3; ++k) {
+					float	q	= std::round((outVertices[i].raw[k] - minimum.raw[k]) / step);
+					positions[i * 4 + k]	= (unsigned short)std::min(65535.0f, std::max(0.0f, q));
+					highest[k]	= std::max(highest[k], positions[i * 4 + k]);
+				}
+			}
+
+			std::vector<signed char>	packedNormals(outNormals.size() * 4, 0);
+			for(size_t i = 0; i < outNormals.size(); ++i) {
+				if(compress) {
+					Meshopt::EncodeOctahedral(outNormals[i].raw, &packedNormals[i * 4]);
+				} else {
+					for(int k = 0; k < 3; ++k)
+						packedNormals[i * 4 + k]	= Meshopt::Snorm8(outNormals[i].raw[k]);
+				}
+			}
+
+			//Same winding as OBJ output, 16 bit indices when vertices fit
+			std::vector<unsigned int>	faces(outIndices.size());
+			for(size_t i = 0; i + 2 < outIndices.size(); i += 3) {
+				faces[i + 0]	= outIndices[i];
+				faces[i + 1]	= outIndices[i + 2];
+				faces[i + 2]	= outIndices[i + 1];
+			}
+			bool	shortIndices	= count < 65535;
+			std::vector<unsigned short>	shortFaces;
+			if(shortIndices)
+				shortFaces.assign(faces.begin(), faces.end());
+
+			//View per accessor, in accessor order
+			struct View {
+				const void*	data;
+				size_t		length;
+				size_t		stride;		//0 for indices
+				size_t		elements;
+				const char*	filter;
+				string		accessor;	//Component type and layout
+			};
+			std::ostringstream	positionAccessor;
+			positionAccessor	<< "\"componentType\":5123,\"type\":\"VEC3\",\"min\":[0,0,0],\"max\":["
+								<< highest[0] << ',' << highest[1] << ',' << highest[2] << ']';
+			std::vector<View>	views;
+			views.push_back({
+				positions.data(), positions.size() * sizeof(unsigned short), 8, count, nullptr, positionAccessor.str()
+			});
+			if(withNormals) {
+				views.push_back({
+					packedNormals.data(), packedNormals.size(), 4, count, "OCTAHEDRAL",
+					"\"componentType\":5120,\"normalized\":true,\"type\":\"VEC3\""
+				});
+			}
+			views.push_back({
+				outColors.data(), outColors.size() * 4, 4, count, nullptr,
+				"\"componentType\":5121,\"normalized\":true,\"type\":\"VEC4\""
+			});
+			views.push_back({
+				shortIndices? static_cast<const void*>(shortFaces.data()): faces.data(),
+				faces.size() * (shortIndices? 2: 4), 0, faces.size(), nullptr,
+				shortIndices? "\"componentType\":5123,\"type\":\"SCALAR\"": "\"componentType\":5125,\"type\":\"SCALAR\""
+			});
+			static_assert(sizeof(vec<uchar>) == 4, "Colors have to be tightly packed RGBA");
+
+			//Binary chunk holds raw views, or compressed streams (raw layout is then fallback buffer)
+			size_t				viewCount	= views.size();
+			std::vector<char>	bin;
+			std::vector<size_t>	rawOffsets(viewCount);
+			std::vector<size_t>	packedOffsets(viewCount);
+			std::vector<size_t>	packedLengths(viewCount);
+			size_t				rawLength	= 0;
+			for(size_t v = 0; v < viewCount; ++v) {
+				rawOffsets[v]	= rawLength;
+				rawLength		+= (views[v].length + 3) / 4 * 4;
+
+				const char*			data	= static_cast<const char*>(views[v].data);
+				std::vector<uchar>	packed;
+				if(compress) {
+					packed	= views[v].stride > 0?
+						Meshopt::EncodeAttributes(reinterpret_cast<const uchar*>(data), count, views[v].stride):
+						Meshopt::EncodeTriangles(faces.data(), faces.size());
+					data	= reinterpret_cast<const char*>(packed.data());
+				}
+				packedOffsets[v]	= bin.size();
+				packedLengths[v]	= compress? packed.size(): views[v].length;
+				bin.insert(bin.end(), data, data + packedLengths[v]);
+				bin.resize((bin.size() + 3) / 4 * 4, 0);
+			}
+
+			const char*	extensions	= compress?
+				"[\"KHR_mesh_quantization\",\"EXT_meshopt_compression\"]": "[\"KHR_mesh_quantization\"]";
+			std::ostringstream	json;
+			json	<< std::setprecision(9)
+					<< "{\"asset\":{\"version\":\"2.0\",\"generator\":\"vox2mc\"},"
+					<< "\"extensionsUsed\":" << extensions << ",\"extensionsRequired\":" << extensions << ','
+					<< "\"scene\":0,\"scenes\":[{\"nodes\":[0]}],"
+					<< "\"nodes\":[{\"mesh\":0,\"name\":\"" << Helper::EscapeJSON(name == ""? "Model": name) << "\","
+					<< "\"translation\":[" << minimum.x << ',' << minimum.y << ',' << minimum.z << "],"
+					<< "\"scale\":[" << step << ',' << step << ',' << step << "]}],"
+					<< "\"meshes\":[{\"primitives\":[";
+			for(size_t r = 0; r < groups; ++r) {
+				json	<< (r > 0? ",": "") << "{\"attributes\":{\"POSITION\":0,"
+						<< (withNormals? "\"NORMAL\":1,": "") << "\"COLOR_0\":" << viewCount - 2 << "},"
+						<< "\"indices\":" << viewCount - 1 + r;
+				if(not plain)
+					json	<< ",\"material\":" << r;
+				json	<< ",\"mode\":4}";
+			}
+			json	<< "]}]" << GLTFMaterials(ranges) << ','
+					<< "\"buffers\":[{\"byteLength\":" << bin.size() << '}';
+			if(compress)
+				json	<< ",{\"byteLength\":" << rawLength << ",\"extensions\":{\"EXT_meshopt_compression\":{\"fallback\":true}}}";
+			json	<< "],\"bufferViews\":[";
+			for(size_t v = 0; v < viewCount; ++v) {
+				json	<< (v > 0? ",": "")
+						<< "{\"buffer\":" << (compress? 1: 0)
+						<< ",\"byteOffset\":" << (compress? rawOffsets[v]: packedOffsets[v])
+						<< ",\"byteLength\":" << views[v].length;
+				if(views[v].stride > 0)
+					json	<< ",\"byteStride\":" << views[v].stride;
+				json	<< ",\"target\":" << (views[v].stride > 0? 34962: 34963);
+				if(compress) {
+					json	<< ",\"extensions\":{\"EXT_meshopt_compression\":{\"buffer\":0"
+							<< ",\"byteOffset\":" << packedOffsets[v] << ",\"byteLength\":" << packedLengths[v]
+							<< ",\"byteStride\":" << (views[v].stride > 0? views[v].stride: (shortIndices? 2: 4))
+							<< ",\"count\":" << views[v].elements
+							<< ",\"mode\":\"" << (views[v].stride > 0? "ATTRIBUTES": "TRIANGLES") << '"';
+					if(views[v].filter)
+						json	<< ",\"filter\":\"" << views[v].filter << '"';
+					json	<< "}}";
+				}
+				json	<< '}';
+			}
+			json	<< "],\"accessors\":[";
+			for(size_t v = 0; v < viewCount - 1; ++v) {
+				json	<< (v > 0? ",": "")
+						<< "{\"bufferView\":" << v << ",\"count\":" << views[v].elements << ',' << views[v].accessor << '}';
+			}
+			//Indices accessor per material range, all in one view
+			for(size_t r = 0; r < groups; ++r) {
+				json	<< ",{\"bufferView\":" << viewCount - 1;
+				if(not plain)
+					json	<< ",\"byteOffset\":" << ranges[r].begin * 3 * (shortIndices? 2: 4);
+				json	<< ",\"count\":" << (plain? views[viewCount - 1].elements: (ranges[r].end - ranges[r].begin) * 3)
+						<< ',' << views[viewCount - 1].accessor << '}';
+			}
+			json	<< "]}";
+			return WriteGLB(hFile, json.str(), bin);
+		}
+
+		/*
+			MTL entries of non diffuse materials used by mesh (diffuse ones
+			use "palette" entry), same texture keeps palette colors. PBR
+			values go to common "Pm"/"Pr" extension. Streamed model has no
+			mesh left, so it gets every material of palette.
+		*/
+		string MaterialLibrary(string texturePath) const {
+			int					group[256];
+			std::vector<int>	firstPalette;
+			MaterialGroups(group, firstPalette);
+			std::vector<char>	used(firstPalette.size(), colors.empty());
+			for(size_t i = 0; i < colors.size(); i += 3)
+				used[group[colors[i]]]	= true;
+
+			std::ostringstream	mtl;
+			mtl	<< std::fixed << std::setprecision(3);
+			for(size_t g = 0; g < firstPalette.size(); ++g) {
+				const VOX::Material&	material	= materials[firstPalette[g]];
+				const vec<uchar>&		color		= palette[firstPalette[g]];
+				float					emit		= std::min(1.0f, material.emit) / 255.0f;
+				if(not used[g] or material.type == VOX::Material::DIFFUSE)
+					continue;
+				mtl	<< "\nnewmtl " << MaterialName(firstPalette[g]) << '\n'
+					<< "illum " << (material.trans > 0.0f? 4: 2) << '\n'
+					<< "Ka 0.000 0.000 0.000\n"
+					<< "Kd 1.000 1.000 1.000\n"
+					<< "Ks " << material.metal << ' ' << material.metal << ' ' << material.metal << '\n'
+					<< "Ke " << color.r * emit << ' ' << color.g * emit << ' ' << color.b * emit << '\n'
+					<< "d " << (1.0f - material.trans) << '\n'
+					<< "Ni " << material.ior << '\n'
+					<< "Pm " << material.metal << '\n'
+					<< "Pr " << material.rough << '\n'
+					<< "map_Kd " << texturePath << '\n';
+			}
+			return mtl.str();
+		}
+
+		//256x1 texture where pixel N is palette index N (matches OBJ "vt" coordinates)
+		bool SavePalette(string path) {
+			return PNG::WriteRGBA(path, palette[0].raw, 256, 1);
 		}
 
 	private:
-		const coord	corner[27] {
+		//GLB container: header, JSON chunk (space padded) and binary chunk
+		static bool WriteGLB(ofstream& hFile, string header, const std::vector<char>& bin) {
+			header.append((4 - header.size() % 4) % 4, ' ');
+
+			unsigned int	jsonLength	= header.size();
+			unsigned int	binLength	= bin.size();
+			unsigned int	fileHeader[3]	= {
+				0x46546C67,	//glTF
+				2,
+				12 + 8 + jsonLength + 8 + binLength
+			};
+			unsigned int	jsonChunk[2]	= {jsonLength, 0x4E4F534A};
+			unsigned int	binChunk[2]		= {binLength, 0x004E4942};
+
+			hFile.write(reinterpret_cast<char*>(fileHeader), sizeof(fileHeader));
+			hFile.write(reinterpret_cast<char*>(jsonChunk), sizeof(jsonChunk));
+			hFile.write(header.data(), header.size());
+			hFile.write(reinterpret_cast<char*>(binChunk), sizeof(binChunk));
+			hFile.write(bin.data(), bin.size());
+
+			hFile.flush();
+			hFile.close();
+			return not hFile.fail();
+		}
+
+		/*
+			Fills normal stream (normals, normalIndices per corner) in
+			output winding (faces i, i + 2, i + 1):
+				FLAT_NORMALS	- face normal, equal directions are shared
+				SMOOTH_NORMALS	- area weighted mean of faces around vertex,
+								  faces over creaseAngle away from corner's
+								  face are left out (one normal per group)
+			Faces are evaluated in parallel, then every vertex gathers its
+			own faces, so threads never write to shared sums.
+		*/
+		void GenerateNormals(NormalMode mode) {
+			normals.clear();
+			normalIndices.clear();
+			if(mode == NO_NORMALS or mode == AUTO_NORMALS)
+				return;
+
+			int					triangles	= indices.size() / 3;
+			std::vector<vertex>	areas(triangles);	//Cross product, length = 2 * area
+			std::vector<vertex>	units(triangles);
+#ifdef __unix__
+			#pragma omp parallel for
+#endif
+			for(int t = 0; t < triangles; ++t) {
+				vertex	cross	= FaceCross(vertices[indices[t * 3]], vertices[indices[t * 3 + 2]], vertices[indices[t * 3 + 1]]);
+				areas[t]	= cross;
+				units[t]	= UnitNormal(cross);
+			}
+			normalIndices.resize(indices.size());
+
+			if(mode == FLAT_NORMALS) {
+				//Shared by 16 bit quantized direction
+				std::map<long long, int>	shared;
+				for(int t = 0; t < triangles; ++t) {
+					auto	it	= shared.emplace(NormalKey(units[t]), int(normals.size()));
+					if(it.second)
+						normals.push_back(units[t]);
+					std::fill(normalIndices.begin() + t * 3, normalIndices.begin() + t * 3 + 3, it.first->second);
+				}
+				return;
+			}
+
+			//Vertex => its corners (offsets + flat list)
+			int					vertexCount	= vertices.size();
+			std::vector<int>	first(vertexCount + 1, 0);
+			for(int index : indices)
+				++first[index + 1];
+			for(int v = 0; v < vertexCount; ++v)
+				first[v + 1]	+= first[v];
+			std::vector<int>	corners(indices.size());
+			std::vector<int>	fill(first.begin(), first.end() - 1);
+			for(size_t i = 0; i < indices.size(); ++i)
+				corners[fill[indices[i]]++]	= i;
+
+			//Per corner normal and its slot among distinct normals of vertex
+			float				limit	= std::cos(std::min(180.0f, std::max(0.0f, creaseAngle)) * 3.14159265f / 180.0f);
+			std::vector<vertex>	cornerNormals(indices.size());
+			std::vector<int>	slots(indices.size());
+			std::vector<int>	distinct(vertexCount + 1, 0);
+#ifdef __unix__
+			#pragma omp parallel for schedule(dynamic, 1024)
+#endif
+			for(int v = 0; v < vertexCount; ++v) {
+				for(int k = first[v]; k < first[v + 1]; ++k) {
+					const vertex&	face	= units[corners[k] / 3];
+					vertex			sum(0, 0, 0);
+					for(int j = first[v]; j < first[v + 1]; ++j) {
+						const vertex&	other	= units[corners[j] / 3];
+						if(face.x * other.x + face.y * other.y + face.z * other.z >= limit - 1e-5f) {
+							const vertex&	area	= areas[corners[j] / 3];
+							sum.Set(sum.x + area.x, sum.y + area.y, sum.z + area.z);
+						}
+					}
+					vertex&	normal	= cornerNormals[corners[k]];
+					normal	= UnitNormal(sum);
+
+					int&	slot	= slots[corners[k]];
+					slot	= -1;
+					for(int j = first[v]; j < k and slot < 0; ++j) {
+						const vertex&	other	= cornerNormals[corners[j]];
+						if(other.x == normal.x and other.y == normal.y and other.z == normal.z)
+							slot	= slots[corners[j]];
+					}
+					if(slot < 0)
+						slot	= distinct[v + 1]++;
+				}
+			}
+			for(int v = 0; v < vertexCount; ++v)
+				distinct[v + 1]	+= distinct[v];
+
+			normals.resize(distinct[vertexCount]);
+#ifdef __unix__
+			#pragma omp parallel for
+#endif
+			for(int v = 0; v < vertexCount; ++v) {
+				for(int k = first[v]; k < first[v + 1]; ++k) {
+					int	corner	= corners[k];
+					normalIndices[corner]	= distinct[v] + slots[corner];
+					normals[normalIndices[corner]]	= cornerNormals[corner];
+				}
+			}
+		}
+
+		//Cross product of triangle A, B, C edges (normal scaled by 2 * area)
+		static vertex FaceCross(const vertex& A, const vertex& B, const vertex& C) {
+			float	u[3]	= {B.x - A.x, B.y - A.y, B.z - A.z};
+			float	v[3]	= {C.x - A.x, C.y - A.y, C.z - A.z};
+			return vertex(u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0]);
+		}
+
+		//16 bit quantized direction, flat normals with same key are shared
+		static long long NormalKey(const vertex& normal) {
+			long long	key	= 0;
+			for(int k = 0; k < 3; ++k)
+				key	= key * 65536 + (long long)std::lround(normal.raw[k] * 32767.0f) + 32768;
+			return key;
+		}
+
+		//Normalized direction, degenerate (zero) one points up
+		static vertex UnitNormal(const vertex& direction) {
+			float	length	= std::sqrt(direction.x * direction.x + direction.y * direction.y + direction.z * direction.z);
+			if(length <= 0.0f)
+				return vertex(0.0f, 1.0f, 0.0f);
+			return vertex(direction.x / length, direction.y / length, direction.z / length);
+		}
+
+		void CopyPalette(VOX& vox) {
+			for(int i = 0; i < 256; ++i) {
+				palette[i].Set(vox.AccessPalleteColor(i));
+				materials[i]	= vox.AccessMaterial(i);
+			}
+		}
+
+		//Triangles begin..end (exclusive) drawn with material of palette index
+		struct MaterialRange {
+			int		palette;
+			size_t	begin;
+			size_t	end;
+		};
+
+		//Emissive materials also need same color, light is not vertex colored
+		bool SameMaterial(int a, int b) const {
+			return	materials[a] == materials[b] and (
+						materials[a].emit <= 0.0f or (
+							palette[a].r == palette[b].r and palette[a].g == palette[b].g and palette[a].b == palette[b].b
+						)
+					);
+		}
+
+		//Group of every palette index, groups are in order of (and named after) their first palette index
+		void MaterialGroups(int (&group)[256], std::vector<int>& firstPalette) const {
+			for(int p = 0; p < 256; ++p) {
+				group[p]	= -1;
+				for(size_t g = 0; g < firstPalette.size() and group[p] < 0; ++g)
+					if(SameMaterial(p, firstPalette[g]))
+						group[p]	= g;
+				if(group[p] < 0) {
+					group[p]	= firstPalette.size();
+					firstPalette.push_back(p);
+				}
+			}
+		}
+
+		/*
+			Counting sort of triangles (with their colors) by material,
+			palette indices of same material share one range and every
+			diffuse one is plain vertex colored "palette". Stable, so
+			vertex cache order survives inside ranges. Returns non empty
+			ranges in order of their first palette index.
+		*/
+		std::vector<MaterialRange> SortByMaterial() {
+			int					group[256];
+			std::vector<int>	firstPalette;
+			MaterialGroups(group, firstPalette);
+
+			size_t				triangles	= indices.size() / 3;
+			std::vector<size_t>	start(firstPalette.size() + 1, 0);
+			bool				sorted		= true;
+			for(size_t t = 0; t < triangles; ++t) {
+				int	g	= group[colors[t * 3]];
+				++start[g + 1];
+				sorted	= sorted and (t == 0 or group[colors[t * 3 - 3]] <= g);
+			}
+			for(size_t g = 0; g < firstPalette.size(); ++g)
+				start[g + 1]	+= start[g];
+
+			if(not sorted) {
+				std::vector<int>	newIndices(indices.size());
+				std::vector<uchar>	newColors(colors.size());
+				std::vector<size_t>	fill(start.begin(), start.end() - 1);
+				for(size_t t = 0; t < triangles; ++t) {
+					size_t	to	= fill[group[colors[t * 3]]]++;
+					std::copy(indices.begin() + t * 3, indices.begin() + t * 3 + 3, newIndices.begin() + to * 3);
+					std::copy(colors.begin() + t * 3, colors.begin() + t * 3 + 3, newColors.begin() + to * 3);
+				}
+				indices.swap(newIndices);
+				colors.swap(newColors);
+			}
+
+			std::vector<MaterialRange>	ranges;
+			for(size_t g = 0; g < firstPalette.size(); ++g)
+				if(start[g + 1] > start[g])
+					ranges.push_back({firstPalette[g], start[g], start[g + 1]});
+			return ranges;
+		}
+
+		//Single diffuse (or no) range, written without any material as before
+		bool PlainMaterial(const std::vector<MaterialRange>& ranges) const {
+			return ranges.empty() or (ranges.size() == 1 and materials[ranges[0].palette].type == VOX::Material::DIFFUSE);
+		}
+
+		//"palette" for diffuse, type and voxel color index otherwise ("glass_12")
+		string MaterialName(int index) const {
+			static const char*	types[]	= {"palette", "metal", "glass", "emit", "blend", "media"};
+			if(materials[index].type == VOX::Material::DIFFUSE)
+				return types[0];
+			return string(types[materials[index].type]) + "_" + std::to_string(index + 1);
+		}
+
+		//glTF "materials" (with leading comma) of ranges, primitive N uses material N
+		string GLTFMaterials(const std::vector<MaterialRange>& ranges) const {
+			if(PlainMaterial(ranges))
+				return "";
+			std::ostringstream	json;
+			json	<< std::setprecision(6) << ",\"materials\":[";
+			for(size_t r = 0; r < ranges.size(); ++r) {
+				const VOX::Material&	material	= materials[ranges[r].palette];
+				const vec<uchar>&		color		= palette[ranges[r].palette];
+				bool					diffuse		= material.type == VOX::Material::DIFFUSE;
+				float					emit		= std::min(1.0f, material.emit);
+				json	<< (r > 0? ",": "")
+						<< "{\"name\":\"" << MaterialName(ranges[r].palette) << "\",\"pbrMetallicRoughness\":{"
+						<< "\"baseColorFactor\":[1,1,1," << (1.0f - material.trans) << "],"
+						<< "\"metallicFactor\":" << material.metal << ",\"roughnessFactor\":" << (diffuse? 1.0f: material.rough) << '}';
+				if(material.trans > 0.0f)
+					json	<< ",\"alphaMode\":\"BLEND\"";
+				if(emit > 0.0f) {
+					json	<< ",\"emissiveFactor\":["
+							<< color.r / 255.0f * emit << ',' << color.g / 255.0f * emit << ',' << color.b / 255.0f * emit << ']';
+				}
+				json	<< '}';
+			}
+			json	<< ']';
+			return json.str();
+		}
+
+		/*
+			Per vertex color (and normal) streams, vertex used by faces of
+			different colors (or with different corner normals) is duplicated.
+			Normals are taken from normal stream when outNormals is given and
+			GenerateNormals made one.
+		*/
+		void BuildColoredVertices(
+			std::vector<vertex>& outVertices, std::vector<vec<uchar>>& outColors, std::vector<int>& outIndices,
+			std::vector<vertex>* outNormals = nullptr
+		) {
+			bool	withNormals	= outNormals and not normalIndices.empty();
+
+			//First attributes of every vertex map directly, rare extra splits go to map
+			std::vector<int>		firstSplit(vertices.size(), -1);
+			std::vector<long long>	firstKey(vertices.size(), 0);
+			std::map<std::pair<int, long long>, int>	extraSplits;
+
+			outVertices.reserve(vertices.size());
+			outColors.reserve(vertices.size());
+			outIndices.resize(indices.size());
+			for(size_t i = 0; i < indices.size(); ++i) {
+				int			vert	= indices[i];
+				uchar		color	= colors[i];
+				long long	key		= color + (withNormals? 256ll * normalIndices[i]: 0);
+
+				int*	split	= nullptr;
+				if(firstSplit[vert] == -1 or firstKey[vert] == key) {
+					firstKey[vert]	= key;
+					split	= &firstSplit[vert];
+				} else {
+					auto	it	= extraSplits.emplace(std::make_pair(vert, key), -1).first;
+					split	= &it->second;
+				}
+
+				if(*split == -1) {
+					*split	= outVertices.size();
+					outVertices.push_back(vertices[vert]);
+					outColors.push_back(palette[color]);
+					if(withNormals)
+						outNormals->push_back(normals[normalIndices[i]]);
+				}
+				outIndices[i]	= *split;
+			}
+		}
+
+		//Upscales source and removes corner/edge voxels, returns final grid (vox2)
+		//Optional crop is given in source voxels of transformed grid (max exclusive)
+		VOX& PrepareGrid(
+			VOX& vox, float upscale, std::unique_ptr<VOX>& vox1, std::unique_ptr<VOX>& vox2,
+			coord cropMin = coord(0, 0, 0), coord cropMax = coord(INT_MAX, INT_MAX, INT_MAX)
+		) {
+			//Flips and rotation fix are read straight from source, no extra pass
+			VOX::TransformedView	source(vox, transform.Then(AxisTransform::MagicaToUnity()));
+			coord					crop;
+			for(int i = 0; i < 3; ++i) {
+				cropMax.raw[i]	= std::min(cropMax.raw[i], source.Size().raw[i]);
+				crop.raw[i]		= std::max(0, cropMax.raw[i] - cropMin.raw[i]);
+			}
+			vec<int>				pos(
+				crop.x * upscale, crop.y * upscale, crop.z * upscale
+			);
+
+			//Space allocation, grids come from pool when converting many files
+			vox2	= gridPool? gridPool->Acquire(): std::unique_ptr<VOX>(new VOX());
+			vox2->SetLayout(gridLayout);
+			VOX&		finalVox	= *vox2;
+
+			//Integer factors: upscale & corner removal in one pass driven by shell mask
+			int			factor		= upscale == floor(upscale)? int(upscale): 0;
+			if(factor >= 1 and factor <= 4) {
+				finalVox.Resize(pos);
+				ShellMask	shell(source, cropMin, crop);
+				switch(factor) {
+					case 1:		UpscaleShell<1>(source, cropMin, crop, shell, finalVox);	break;
+					case 2:		UpscaleShell<2>(source, cropMin, crop, shell, finalVox);	break;
+					case 3:		UpscaleShell<3>(source, cropMin, crop, shell, finalVox);	break;
+					default:	UpscaleShell<4>(source, cropMin, crop, shell, finalVox);	break;
+				}
+				return finalVox;
+			}
+
+			vox1	= gridPool? gridPool->Acquire(): std::unique_ptr<VOX>(new VOX());
+			vox1->SetLayout(gridLayout);
+			vox1->Resize(pos);
+			finalVox.Resize(pos, false);	//Every voxel is written by corner removal
+			VOX&		newVox		= *vox1;
+
+			//Scalling
+			UpscaleVoxels(source, cropMin, crop, newVox, upscale);
+
+			//Removing corner/edge voxels, in memory order of grid
+			newVox.ForEachVoxel([&](const VOX::Cursor& voxel) {
+				uchar	ID	= voxel.Get();
+
+				//Corners/Edge ignoring
+				for(int i = 0; i < 6 and ID > 0; ++i)
+					if(voxel.Neighbour(colorGrab[i].x, colorGrab[i].y, colorGrab[i].z) == 0)
+						ID	= 0;
+
+				finalVox.SetVoxelRaw(voxel.x, voxel.y, voxel.z, ID);
+			});
+			return finalVox;
+		}
+
+		void ReleaseGrids(std::unique_ptr<VOX>& vox1, std::unique_ptr<VOX>& vox2) {
+			if(gridPool) {
+				gridPool->Release(std::move(vox1));
+				gridPool->Release(std::move(vox2));
+			}
+		}
+
+		/*
+			Corner states and edge vertex indices of one layer of cubes
+			(lattice planes z and z + 1). MC vertex lies always in the middle
+			of an edge so (point, axis) identifies it. Cubes span -1..size, so
+			lattice points span -1..size + 1. Memory O(X * Y) per thread.
+		*/
+		class LayerEdges {
+			public:
+				int					pointsX;
+				int					pointsY;
+				std::vector<uchar>	inside[2];		//Corner states of lower/upper plane
+				std::vector<int>	planes[2];		//X/Y edges of lower/upper plane, point * 2 + axis
+				std::vector<int>	vertical;		//Z edges between planes
+				std::vector<uchar>	rowCases;		//Cube cases of one row
+				std::vector<uchar>	zeros;			//Empty voxel row, stands for rows outside of grid
+
+				LayerEdges(int sizeX, int sizeY)
+					:	pointsX(sizeX + 3), pointsY(sizeY + 3)
+				{
+					for(int i = 0; i < 2; ++i) {
+						inside[i].assign(pointsX * pointsY, 0);
+						planes[i].assign(pointsX * pointsY * 2, -1);
+					}
+					vertical.assign(pointsX * pointsY, -1);
+					rowCases.assign(pointsX, 0);
+					zeros.assign(sizeX, 0);
+				}
+
+				inline int Point(int x, int y) const {
+					return (x + 1) + pointsX * (y + 1);
+				}
+
+				/*
+					Bits of cube corners (Bourke order), same as 27 neighbours
+					lookup, for cubes -1..size of row y into rowCases[x + 1]
+				*/
+				inline void CubeRow(int y) {
+					int		p	= Point(-1, y);
+					Simd::CubeRow(&inside[0][p], &inside[1][p], pointsX, pointsX - 1, rowCases.data());
+				}
+
+				inline int At(const coord& cube, int edge) const {
+					const coord&	a	= edgeOffset[edge][0];
+					const coord&	b	= edgeOffset[edge][1];
+					int				point	= Point(cube.x + a.x, cube.y + a.y);
+
+					if(a.z not_eq b.z)
+						return vertical[point];
+					return planes[a.z][point * 2 + (a.x not_eq b.x? 0: 1)];
+				}
+		};
+
+		/*
+			Meshes layer of cubes between lattice planes layer - 1 and layer
+			into buffers, vertices and corners are numbered by prefix sums of
+			CountMarchingCubes and stored vertexShift/cornerShift lower
+			(streaming keeps only part of mesh). Optional faceNormals get
+			unit normal of every triangle (same as flat GenerateNormals).
+			Runs on already upscaled grid, upscale factor never enters it
+			(only UpscaleShell is templated on it), trip counts come from
+			cube case.
+		*/
+		void MeshLayer(
+			VOX& finalVox, const std::vector<MeshStats>& layers, int layer, LayerEdges& edges,
+			float scale, const vertex& center, vertex* faceNormals = nullptr
+		) {
+			int		z		= layer - 1;
+			size_t	vert	= layers[layer].vertices;
+			size_t	index	= layers[layer].triangles * 3 - cornerShift;
+
+			//Lower plane vertices were numbered by previous layer, same order
+			ClassifyPlane(finalVox, z, edges, 0);
+			ClassifyPlane(finalVox, z + 1, edges, 1);
+			NumberPlaneEdges(edges, 0, layer > 0? layers[layer - 1].vertices: 0, nullptr, 0, 0);
+			vert	+= NumberPlaneEdges(edges, 1, vert, &finalVox, z + 1, scale, center);
+			vert	+= NumberVerticalEdges(edges, vert, z, scale, center);
+
+			for(int y = -1; y <= finalVox.SizeY(); ++y) {
+				edges.CubeRow(y);
+				for(int x = -1; x <= finalVox.SizeX(); ++x) {
+					uchar	bits	= edges.rowCases[x + 1];
+					if(bits == 0 or bits == 255 or not InWindow(x, y, z))
+						continue;
+
+					bits -= 1;
+
+					int		triangulationVert	= cases.triangles[bits] * 3;
+					coord	pos(x, y, z);
+					for(int i = 0; i < triangulationVert; ++i)
+						indices[index + i]	= edges.At(pos, triangulation[bits][i]);
+
+					//Corners recomputed from cube edges, vertices of lower plane may not be in buffer
+					for(int i = 0; faceNormals and i < triangulationVert; i += 3) {
+						vertex	corner[3];
+						for(int c = 0; c < 3; ++c) {
+							const coord*	edge	= edgeOffset[triangulation[bits][i + c]];
+							corner[c]	= EdgeVertex(pos + edge[0], pos + edge[1], scale, center);
+						}
+						faceNormals[(index + i) / 3]	= UnitNormal(FaceCross(corner[0], corner[2], corner[1]));
+					}
+
+					uchar	color	= 0;
+					for(size_t i = 0; i < sizeof(colorGrab) / sizeof(colorGrab[0]); ++i) {
+						int ID = finalVox.GetVoxel(colorGrab[i] + pos);
+						if(ID not_eq 0) {
+							color	= ID - 1;
+							break;
+						}
+					}
+					std::fill(colors.begin() + index, colors.begin() + index + triangulationVert, color);
+					index	+= triangulationVert;
+				}
+			}
+		}
+
+		/*
+			Lattice point is inside when any voxel touching it is solid.
+			Linear grids build whole point rows from 4 voxel rows around
+			them (Simd::LatticeRow), tiled ones spread voxel by voxel.
+		*/
+		static void ClassifyPlane(VOX& grid, int z, LayerEdges& edges, int slot) {
+			std::vector<uchar>&	inside	= edges.inside[slot];
+			int					pointsX	= edges.pointsX;
+			std::fill(inside.begin(), inside.end(), 0);
+
+			if(grid.GetLayout() == VOX::LINEAR and grid.SizeX() > 0) {
+				auto	row		= [&](int y, int slice) -> const uchar* {
+					bool	inGrid	= y >= 0 and y < grid.SizeY() and slice >= 0 and slice < grid.SizeZ();
+					return inGrid? grid.LinearRow(y, slice): edges.zeros.data();
+				};
+				//Point row y lies between voxel rows y - 1 and y
+				for(int y = 0; y <= grid.SizeY(); ++y) {
+					const uchar*	rows[4]	= {row(y - 1, z - 1), row(y, z - 1), row(y - 1, z), row(y, z)};
+					Simd::LatticeRow(rows, grid.SizeX(), &inside[1 + pointsX * (y + 1)]);
+				}
+				return;
+			}
+
+			//Solid voxels of slices z - 1 and z spread to their 4 upper lattice points
+			for(int slice = z - 1; slice <= z; ++slice) {
+				if(slice < 0 or slice >= grid.SizeZ())
+					continue;
+				for(int y = 0; y < grid.SizeY(); ++y) {
+					for(int x = 0; x < grid.SizeX(); ++x) {
+						if(grid.GetVoxelRaw(x, y, slice) == 0)
+							continue;
+						int	p	= (x + 1) + pointsX * (y + 1);
+						inside[p]				= 1;
+						inside[p + 1]			= 1;
+						inside[p + pointsX]		= 1;
+						inside[p + pointsX + 1]	= 1;
+					}
+				}
+			}
+		}
+
+		//Output position of vertex in the middle of lattice edge a-b
+		inline vertex EdgeVertex(const coord& a, const coord& b, float scale, const vertex& center) const {
+			vertex	v1(
+				(a.x + origin.x) + offset.x, (a.y + origin.y) + offset.y, (a.z + origin.z) + offset.z
+			);
+			vertex	v2(
+				(b.x + origin.x) + offset.x, (b.y + origin.y) + offset.y, (b.z + origin.z) + offset.z
+			);
+			return vertex(((v1 + v2) * 0.5f - center) * scale);
+		}
+
+		/*
+			Numbers crossed X/Y edges of plane (raster order, X edge before Y
+			edge of each point) starting at base. With grid given also writes
+			vertex positions. Returns number of crossed edges.
+		*/
+		size_t NumberPlaneEdges(
+			LayerEdges& edges, int slot, size_t base,
+			VOX* grid, int z, float scale, const vertex& center = vertex()
+		) {
+			const std::vector<uchar>&	inside	= edges.inside[slot];
+			std::vector<int>&			indices	= edges.planes[slot];
+			size_t						count	= 0;
+			for(int y = -1; y <= edges.pointsY - 2; ++y) {
+				for(int x = -1; x <= edges.pointsX - 2; ++x) {
+					int	p	= edges.Point(x, y);
+					for(int axis = 0; axis < 2; ++axis) {
+						int	q	= axis == 0? p + 1: p + edges.pointsX;
+						if((axis == 0? x: y) == (axis == 0? edges.pointsX: edges.pointsY) - 2
+						or inside[p] == inside[q]) {
+							indices[p * 2 + axis]	= -1;
+							continue;
+						}
+
+						indices[p * 2 + axis]	= base + count;
+						if(grid not_eq nullptr) {
+							coord	a(x, y, z);
+							coord	b(x + (axis == 0), y + (axis == 1), z);
+							vertices[base + count - vertexShift]	= EdgeVertex(a, b, scale, center);
+						}
+						++count;
+					}
+				}
+			}
+			return count;
+		}
+
+		//Numbers crossed Z edges between planes (raster order) and writes their vertices
+		size_t NumberVerticalEdges(LayerEdges& edges, size_t base, int z, float scale, const vertex& center) {
+			size_t	count	= 0;
+			for(int y = -1; y <= edges.pointsY - 2; ++y) {
+				for(int x = -1; x <= edges.pointsX - 2; ++x) {
+					int	p	= edges.Point(x, y);
+					if(edges.inside[0][p] == edges.inside[1][p]) {
+						edges.vertical[p]	= -1;
+						continue;
+					}
+					edges.vertical[p]		= base + count;
+					vertices[base + count - vertexShift]	= EdgeVertex(coord(x, y, z), coord(x, y, z + 1), scale, center);
+					++count;
+				}
+			}
+			return count;
+		}
+
+		inline bool InWindow(int x, int y, int z) const {
+			return	x >= windowMin.x and y >= windowMin.y and z >= windowMin.z
+				and	x <= windowMax.x and y <= windowMax.y and z <= windowMax.z;
+		}
+
+		//Removes vertices no triangle refers to, keeps order of the rest
+		void DropUnusedVertices() {
+			std::vector<int>	remap(vertices.size(), -1);
+			for(int index : indices)
+				remap[index]	= 0;
+
+			size_t	count	= 0;
+			for(size_t i = 0; i < vertices.size(); ++i) {
+				if(remap[i] < 0)
+					continue;
+				remap[i]			= count;
+				vertices[count++]	= vertices[i];
+			}
+			vertices.resize(count);
+			for(int& index : indices)
+				index	= remap[index];
+		}
+
+		/*
+			Counting pass over classified cube cases, layers receive exclusive
+			prefix sums (first vertex/triangle of every layer of cubes).
+			Layer owns crossed X/Y edges of its upper plane and its Z edges.
+		*/
+		MeshStats CountMarchingCubes(VOX& finalVox, std::vector<MeshStats>& layers) {
+			int		layerCount	= finalVox.SizeZ() + 2;
+			layers.assign(layerCount, MeshStats());
+#ifdef __unix__
+			#pragma omp parallel
+#endif
+			{
+				LayerEdges	edges(finalVox.SizeX(), finalVox.SizeY());
+#ifdef __unix__
+				#pragma omp for schedule(dynamic)
+#endif
+				for(int layer = 0; layer < layerCount; ++layer) {
+					int		z	= layer - 1;
+					ClassifyPlane(finalVox, z, edges, 0);
+					ClassifyPlane(finalVox, z + 1, edges, 1);
+
+					MeshStats&	stats	= layers[layer];
+					stats.vertices	= NumberPlaneEdges(edges, 1, 0, nullptr, 0, 0);
+					for(int y = -1; y <= finalVox.SizeY() + 1; ++y) {
+						if(y <= finalVox.SizeY())
+							edges.CubeRow(y);
+						for(int x = -1; x <= finalVox.SizeX() + 1; ++x) {
+							int	p	= edges.Point(x, y);
+							stats.vertices	+= edges.inside[0][p] not_eq edges.inside[1][p];
+
+							if(x > finalVox.SizeX() or y > finalVox.SizeY())
+								continue;
+							uchar	bits	= edges.rowCases[x + 1];
+							if(bits not_eq 0 and bits not_eq 255 and InWindow(x, y, z))
+								stats.triangles	+= cases.triangles[bits - 1];
+						}
+					}
+				}
+			}
+
+			MeshStats	total;
+			for(MeshStats& stats : layers) {
+				MeshStats	count	= stats;
+				stats		= total;
+				total.vertices	+= count.vertices;
+				total.triangles	+= count.triangles;
+			}
+			return total;
+		}
+
+		/*
+			Integer upscale fused with corner removal. Upscaled voxel loses
+			its ID when any of its 6 neighbours is empty, which can only
+			happen on block face towards empty source neighbour. Interior
+			(non shell) voxels are plain block fills, neighbours are looked
+			up for shell voxels only.
+		*/
+		template<int U>
+		static void UpscaleShell(
+			const VOX::TransformedView& vox, const coord& from, const coord& size,
+			const ShellMask& shell, VOX& finalVox
+		) {
+#ifdef __unix__
+			#pragma omp parallel for
+#endif
+			for(int y = 0; y < size.y; ++y) {
+				for(int z = 0; z < size.z; ++z) {
+					for(int x = 0; x < size.x; ++x) {
+						uchar	ID	= vox.Get(from.x + x, from.y + y, from.z + z);
+						if(ID == 0)
+							continue;
+
+						int	empty	= shell.Shell(x, y, z)? shell.EmptyFaces(x, y, z): 0;
+						for(int Z = 0; Z < U; ++Z) {
+							int	faceZ	= (Z == 0? empty & 16: 0) | (Z == U - 1? empty & 32: 0);
+							for(int Y = 0; Y < U; ++Y) {
+								int	faceY	= (Y == 0? empty & 4: 0) | (Y == U - 1? empty & 8: 0);
+								for(int X = 0; X < U; ++X) {
+									int	faceX	= (X == 0? empty & 1: 0) | (X == U - 1? empty & 2: 0);
+									finalVox.SetVoxelRaw(
+										U * x + X, U * y + Y, U * z + Z, (faceX | faceY | faceZ)? 0: ID
+									);
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+
+		//Copies every voxel of transformed source into block of generic (also fractional) size
+		static void UpscaleVoxels(
+			const VOX::TransformedView& vox, const coord& from, const coord& size, VOX& newVox, float upscale
+		) {
+#ifdef __unix__
+			#pragma omp parallel for
+#endif
+			for(int y = 0; y < size.y; ++y) {
+				for(int z = 0; z < size.z; ++z) {
+					for(int x = 0; x < size.x; ++x) {
+						uchar	ID	= vox.Get(from.x + x, from.y + y, from.z + z);
+						if(ID == 0)
+							continue;
+
+						//Bounds checked, fractional factors overshoot last block
+						for(float Z = 0; Z < upscale; ++Z)
+							for(float Y = 0; Y < upscale; ++Y)
+								for(float X = 0; X < upscale; ++X)
+									newVox.SetVoxel(
+										upscale * x + X,
+										upscale * y + Y,
+										upscale * z + Z,
+										ID
+									);
+					}
+				}
+			}
+		}
+
+		static constexpr coord	corner[27] = {
 			{-1, -1, -1},
 			{ 0, -1, -1},
 			{ 1, -1, -1},
@@ -324,7 +2010,7 @@ class MarchingCubeModel {
 			{ 0,  1,  1},
 			{ 1,  1,  1}
 		};
-		const uchar	cornerBits[27] {
+		static constexpr uchar	cornerBits[27] = {
 			0b00000001,
 			0b00000011,
 			0b00000010,
@@ -361,7 +2047,7 @@ class MarchingCubeModel {
 			0b11000000,
 			0b01000000
 		};
-		const coord	edgeOffset[12][2] {
+		static constexpr coord	edgeOffset[12][2] = {
 			{{0, 0, 0}, {1, 0, 0}},
 			{{1, 0, 0}, {1, 1, 0}},
 			{{0, 1, 0}, {1, 1, 0}},
@@ -378,7 +2064,7 @@ class MarchingCubeModel {
 			{{0, 1, 0}, {0, 1, 1}}
 		};
 
-		const coord	colorGrab[26] = {
+		static constexpr coord	colorGrab[26] = {
 			//a
 			{0, 1, 0},
 			{1, 0, 0},
@@ -416,7 +2102,7 @@ class MarchingCubeModel {
 			{-1, 1, 1}
 		};
 
-		const int triangulation[254][16] = {
+		static constexpr int triangulation[254][16] = {
 			{0, 8, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
 			{0, 1, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
 			{1, 8, 3, 9, 8, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
@@ -673,6 +2359,8 @@ class MarchingCubeModel {
 			{0, 3, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}
 		};
 
+		static constexpr MarchingCubeCases	cases	= BuildMarchingCubeCases(triangulation);
+
 		static constexpr double halfTexturePixelSize	= 0.001953125;
 		static constexpr double texturePixelSize		= 0.00390625;
 };
@@ -0,0 +1,292 @@
+#ifndef __MESHOPT__
+#define __MESHOPT__
+
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+typedef unsigned char	uchar;
+
+/*
+	Encoders of EXT_meshopt_compression bitstreams (glTF), no external
+	library needed:
+		attributes	- vertex codec v0, byte columns of 16 element groups
+					  delta/zigzag coded and packed to 0/2/4/8 bits
+		triangles	- index codec v1, edge & vertex FIFOs + varint deltas
+		octahedral	- filter, unit vectors as 2 signed components
+*/
+class Meshopt {
+	public:
+		//Vertex data with byteStride (multiple of 4, <= 256) per element
+		static std::vector<uchar> EncodeAttributes(const uchar* data, size_t count, size_t stride) {
+			std::vector<uchar>	out;
+			out.push_back(0xA0);	//Vertex codec, version 0
+
+			uchar	last[256]	= {};
+			if(count > 0)
+				memcpy(last, data, stride);
+			uchar	first[256];
+			memcpy(first, last, stride);
+
+			//Elements per block, multiple of group size, block fits 8KB
+			size_t	blockSize	= std::min<size_t>((8192 / stride) & ~size_t(15), 256);
+			uchar	deltas[256];
+			for(size_t offset = 0; offset < count; offset += blockSize) {
+				size_t	elements	= std::min(blockSize, count - offset);
+				size_t	aligned		= (elements + 15) & ~size_t(15);
+				for(size_t k = 0; k < stride; ++k) {
+					uchar	previous	= last[k];
+					for(size_t i = 0; i < elements; ++i) {
+						uchar	value	= data[(offset + i) * stride + k];
+						uchar	delta	= value - previous;
+						deltas[i]	= (delta << 1) ^ uchar(-(delta >> 7));	//Zigzag
+						previous	= value;
+					}
+					memset(deltas + elements, 0, aligned - elements);
+					EncodeBytes(out, deltas, aligned);
+				}
+				memcpy(last, data + (offset + elements - 1) * stride, stride);
+			}
+
+			//Tail: zero padding to 32 bytes and first element (decoder baseline)
+			if(stride < 32)
+				out.insert(out.end(), 32 - stride, 0);
+			out.insert(out.end(), first, first + stride);
+			return out;
+		}
+
+		//Triangle list, count is number of indices
+		static std::vector<uchar> EncodeTriangles(const unsigned int* indices, size_t count) {
+			std::vector<uchar>	codes;
+			std::vector<uchar>	out;
+			out.push_back(0xE1);	//Index codec, version 1
+
+			unsigned int	edges[16][2];
+			unsigned int	verts[16];
+			memset(edges, -1, sizeof(edges));
+			memset(verts, -1, sizeof(verts));
+			size_t			edgeOffset	= 0;
+			size_t			vertOffset	= 0;
+			unsigned int	next		= 0;
+			unsigned int	last		= 0;
+
+			auto	pushEdge	= [&](unsigned int a, unsigned int b) {
+				edges[edgeOffset][0]	= a;
+				edges[edgeOffset][1]	= b;
+				edgeOffset				= (edgeOffset + 1) & 15;
+			};
+			auto	pushVertex	= [&](unsigned int v) {
+				verts[vertOffset]	= v;
+				vertOffset			= (vertOffset + 1) & 15;
+			};
+			auto	findVertex	= [&](unsigned int v) -> int {
+				for(int i = 0; i < 16; ++i)
+					if(verts[(vertOffset - 1 - i) & 15] == v)
+						return i;
+				return -1;
+			};
+			auto	writeIndex	= [&](unsigned int v) {
+				unsigned int	delta	= v - last;
+				PutVarint(out, (delta << 1) ^ unsigned(int(delta) >> 31));
+				last	= v;
+			};
+
+			for(size_t i = 0; i + 2 < count; i += 3) {
+				unsigned int	tri[3]	= {indices[i], indices[i + 1], indices[i + 2]};
+
+				//Triangle sharing an edge with recent ones (rotated so a-b is that edge)
+				int		edge		= -1;
+				int		rotation	= 0;
+				for(int e = 0; e < 15 and edge < 0; ++e) {
+					unsigned int*	fifo	= edges[(edgeOffset - 1 - e) & 15];
+					for(int r = 0; r < 3; ++r) {
+						if(fifo[0] == tri[r] and fifo[1] == tri[(r + 1) % 3]) {
+							edge		= e;
+							rotation	= r;
+							break;
+						}
+					}
+				}
+
+				if(edge >= 0) {
+					unsigned int	a	= tri[rotation];
+					unsigned int	b	= tri[(rotation + 1) % 3];
+					unsigned int	c	= tri[(rotation + 2) % 3];
+
+					int	fc	= findVertex(c);
+					int	fec	= (fc >= 1 and fc < 13)? fc: (c == next? (next++, 0): 15);
+					if(fec == 15 and c + 1 == last)
+						fec	= 13;
+					else if(fec == 15 and c == last + 1)
+						fec	= 14;
+					codes.push_back((edge << 4) | fec);
+
+					if(fec == 15)
+						writeIndex(c);
+					else if(fec >= 13)
+						last	= c;
+					if(fec == 0 or fec >= 13)
+						pushVertex(c);
+					pushEdge(c, b);
+					pushEdge(a, c);
+					continue;
+				}
+
+				//New triangle, rotated so a is next new vertex when possible
+				rotation	= tri[1] == next? 1: (tri[2] == next? 2: 0);
+				unsigned int	a	= tri[rotation];
+				unsigned int	b	= tri[(rotation + 1) % 3];
+				unsigned int	c	= tri[(rotation + 2) % 3];
+
+				//Restart of index numbering (0, 1, 2) resets decoder
+				bool	reset	= a == 0 and b == 1 and c == 2 and next > 0;
+				if(reset) {
+					next	= 0;
+					memset(verts, -1, sizeof(verts));
+				}
+
+				int		fb		= findVertex(b);
+				int		fc		= findVertex(c);
+				int		fea		= a == next? (next++, 0): 15;
+				int		feb		= (fb >= 0 and fb < 14)? fb + 1: (b == next? (next++, 0): 15);
+				int		fec		= (fc >= 0 and fc < 14)? fc + 1: (c == next? (next++, 0): 15);
+				uchar	aux		= (feb << 4) | fec;
+
+				int		table	= -1;
+				for(int k = 0; k < 14 and table < 0; ++k)
+					if(auxTable[k] == aux)
+						table	= k;
+
+				if(fea == 0 and table >= 0 and not reset) {
+					codes.push_back(0xF0 | table);
+				} else {
+					codes.push_back(0xF0 | 14 | (fea == 15? 1: 0));
+					out.push_back(aux);
+				}
+
+				if(fea == 15)
+					writeIndex(a);
+				if(feb == 15)
+					writeIndex(b);
+				if(fec == 15)
+					writeIndex(c);
+
+				if(fea == 0 or fea == 15)
+					pushVertex(a);
+				if(feb == 0 or feb == 15)
+					pushVertex(b);
+				if(fec == 0 or fec == 15)
+					pushVertex(c);
+				pushEdge(b, a);
+				pushEdge(c, b);
+				pushEdge(a, c);
+			}
+
+			//Header | codes (byte per triangle) | data | aux table (also padding)
+			std::vector<uchar>	result;
+			result.reserve(1 + codes.size() + out.size() + 16);
+			result.push_back(out[0]);
+			result.insert(result.end(), codes.begin(), codes.end());
+			result.insert(result.end(), out.begin() + 1, out.end());
+			result.insert(result.end(), auxTable, auxTable + 16);
+			return result;
+		}
+
+		//Unit vector => 4 signed bytes (u, v, 1, 0) for OCTAHEDRAL filter
+		static void EncodeOctahedral(const float* normal, signed char* out) {
+			float	x		= normal[0];
+			float	y		= normal[1];
+			float	z		= normal[2];
+			float	length	= fabsf(x) + fabsf(y) + fabsf(z);
+			float	inverse	= length == 0.0f? 0.0f: 1.0f / length;
+			x	*= inverse;
+			y	*= inverse;
+
+			float	u	= z >= 0.0f? x: (1.0f - fabsf(y)) * (x >= 0.0f? 1.0f: -1.0f);
+			float	v	= z >= 0.0f? y: (1.0f - fabsf(x)) * (y >= 0.0f? 1.0f: -1.0f);
+			out[0]	= Snorm8(u);
+			out[1]	= Snorm8(v);
+			out[2]	= Snorm8(1.0f);
+			out[3]	= 0;
+		}
+
+		static signed char Snorm8(float value) {
+			value	= value < -1.0f? -1.0f: (value > 1.0f? 1.0f: value);
+			return static_cast<signed char>(int(value * 127.0f + (value >= 0.0f? 0.5f: -0.5f)));
+		}
+
+	private:
+		//Codes 0..13 of new triangles (feb << 4 | fec), 14/15 never used by table
+		static constexpr uchar	auxTable[16]	= {
+			0x00, 0x76, 0x87, 0x56, 0x67, 0x78, 0xA9, 0x86,
+			0x65, 0x89, 0x68, 0x98, 0x01, 0x69, 0x00, 0x00
+		};
+
+		static void PutVarint(std::vector<uchar>& out, unsigned int value) {
+			do {
+				uchar	byte	= value & 127;
+				value	>>= 7;
+				out.push_back(byte | (value? 128: 0));
+			} while(value);
+		}
+
+		//2 bit mode per 16 byte group (0, 2, 4 or 8 bits), then groups
+		static void EncodeBytes(std::vector<uchar>& out, const uchar* bytes, size_t count) {
+			size_t	groups	= count / 16;
+			size_t	header	= out.size();
+			out.insert(out.end(), (groups + 3) / 4, 0);
+
+			for(size_t g = 0; g < groups; ++g) {
+				const uchar*	group	= bytes + g * 16;
+				int				mode	= 3;
+				size_t			best	= 16;
+				for(int m = 0; m < 3; ++m) {
+					size_t	size	= GroupSize(group, m);
+					if(size < best) {
+						best	= size;
+						mode	= m;
+					}
+				}
+				out[header + g / 4]	|= mode << ((g % 4) * 2);
+
+				if(mode == 0)
+					continue;
+				if(mode == 3) {
+					out.insert(out.end(), group, group + 16);
+					continue;
+				}
+				//Packed values (first one in high bits), values >= sentinel follow raw
+				int		bits		= 1 << mode;
+				uchar	sentinel	= (1 << bits) - 1;
+				for(int i = 0; i < 16; i += 8 / bits) {
+					uchar	byte	= 0;
+					for(int k = 0; k < 8 / bits; ++k)
+						byte	= (byte << bits) | std::min(group[i + k], sentinel);
+					out.push_back(byte);
+				}
+				for(int i = 0; i < 16; ++i)
+					if(group[i] >= sentinel)
+						out.push_back(group[i]);
+			}
+		}
+
+		//Encoded size of group in mode, SIZE_MAX when mode cannot hold it
+		static size_t GroupSize(const uchar* group, int mode) {
+			if(mode == 0) {
+				for(int i = 0; i < 16; ++i)
+					if(group[i] not_eq 0)
+						return size_t(-1);
+				return 0;
+			}
+			int		bits		= 1 << mode;
+			uchar	sentinel	= (1 << bits) - 1;
+			size_t	size		= 16 * bits / 8;
+			for(int i = 0; i < 16; ++i)
+				size	+= group[i] >= sentinel;
+			return size;
+		}
+};
+constexpr uchar Meshopt::auxTable[16];
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef __PNG__
+#define __PNG__
+
+#include <string>
+#include <fstream>
+#include <vector>
+
+using std::string;
+using std::ofstream;
+
+typedef unsigned char	uchar;
+
+//Minimal PNG writer (RGBA8, stored deflate blocks), no zlib needed
+class PNG {
+	public:
+		static bool WriteRGBA(string path, const uchar* rgba, int width, int height) {
+			ofstream	hFile(path, std::ios::trunc bitor std::ios::out bitor std::ios::binary);
+			if(hFile.fail())
+				return false;
+
+			//Signature
+			hFile.write("\x89PNG\r\n\x1a\n", 8);
+
+			//Header
+			std::vector<uchar>	header;
+			PutBE(header, width);
+			PutBE(header, height);
+			header.insert(header.end(), {
+				8,	//Bit depth
+				6,	//RGBA
+				0,	//Deflate
+				0,	//Adaptive filtering
+				0	//No interlace
+			});
+			WriteChunk(hFile, "IHDR", header);
+
+			//Scanlines, filter type 0 before each row
+			std::vector<uchar>	raw;
+			size_t				rowSize	= size_t(width) * 4;
+			for(int y = 0; y < height; ++y) {
+				raw.push_back(0);
+				raw.insert(raw.end(), rgba + y * rowSize, rgba + (y + 1) * rowSize);
+			}
+
+			//Zlib stream made of uncompressed deflate blocks
+			std::vector<uchar>	data	= {0x78, 0x01};
+			size_t				pos		= 0;
+			do {
+				size_t	len		= std::min<size_t>(raw.size() - pos, 0xFFFF);
+				bool	last	= pos + len == raw.size();
+				data.push_back(last? 1: 0);
+				data.push_back(len & 0xFF);
+				data.push_back((len >> 8) & 0xFF);
+				data.push_back(~len & 0xFF);
+				data.push_back((~len >> 8) & 0xFF);
+				data.insert(data.end(), raw.begin() + pos, raw.begin() + pos + len);
+				pos		+= len;
+			} while(pos < raw.size());
+			PutBE(data, Adler32(raw));
+			WriteChunk(hFile, "IDAT", data);
+
+			WriteChunk(hFile, "IEND", {});
+
+			hFile.close();
+			return not hFile.fail();
+		}
+
+	private:
+		static void PutBE(std::vector<uchar>& out, unsigned int value) {
+			out.insert(out.end(), {
+				uchar(value >> 24), uchar(value >> 16), uchar(value >> 8), uchar(value)
+			});
+		}
+
+		static void WriteChunk(ofstream& hFile, const char* type, const std::vector<uchar>& content) {
+			std::vector<uchar>	chunk;
+			PutBE(chunk, content.size());
+			chunk.insert(chunk.end(), type, type + 4);
+			chunk.insert(chunk.end(), content.begin(), content.end());
+			//CRC covers type and content
+			PutBE(chunk, CRC32(chunk.data() + 4, chunk.size() - 4));
+			hFile.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+		}
+
+		static unsigned int CRC32(const uchar* data, size_t length) {
+			unsigned int	crc	= 0xFFFFFFFF;
+			for(size_t i = 0; i < length; ++i) {
+				crc ^= data[i];
+				for(int k = 0; k < 8; ++k)
+					crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+			}
+			return ~crc;
+		}
+
+		static unsigned int Adler32(const std::vector<uchar>& data) {
+			unsigned int	a	= 1;
+			unsigned int	b	= 0;
+			for(uchar c : data) {
+				a	= (a + c) % 65521;
+				b	= (b + a) % 65521;
+			}
+			return (b << 16) | a;
+		}
+};
+
+#endif
@@ -139,6 +139,16 @@ class ParamManager {
 					or	(*lastParam) == "-fx"
 					or	(*lastParam) == "-fy"
 					or	(*lastParam) == "-fz"
+					or	(*lastParam) == "-pal"
+					or	(*lastParam) == "-vc"
+					or	(*lastParam) == "-hp"
+					or	(*lastParam) == "-dr"
+					or	(*lastParam) == "-oc"
+					or	(*lastParam) == "-fc"
+					or	(*lastParam) == "-st"
+					or	(*lastParam) == "-dd"
+					or	(*lastParam) == "-q"
+					or	(*lastParam) == "-c"
 					) {
 						(*lastParam).value	= "1";
 					} else if((*lastParam).value not_eq "") {
@@ -0,0 +1,246 @@
+#ifndef __PIPELINE__
+#define __PIPELINE__
+
+#include <vector>
+#include <deque>
+#include <list>
+#include <functional>
+
+#ifdef __unix__
+	#include <thread>
+	#include <mutex>
+	#include <condition_variable>
+#endif
+
+using std::vector;
+
+//Blocking FIFO with fixed capacity, Push waits when full, Pop waits when empty
+template<typename T>
+class BoundedQueue {
+	private:
+		std::deque<T>				items;
+		size_t						capacity;
+		bool						closed		= false;
+#ifdef __unix__
+		std::mutex					lock;
+		std::condition_variable		notFull;
+		std::condition_variable		notEmpty;
+#endif
+
+	public:
+		BoundedQueue(size_t maxItems)
+			: capacity(maxItems < 1? 1: maxItems)
+		{}
+
+		void Push(T item) {
+#ifdef __unix__
+			std::unique_lock<std::mutex>	guard(lock);
+			notFull.wait(guard, [&]() -> bool {
+				return items.size() < capacity;
+			});
+			items.push_back(std::move(item));
+			notEmpty.notify_one();
+#else
+			items.push_back(std::move(item));
+#endif
+		}
+
+		//Returns false when queue is closed and drained
+		bool Pop(T& item) {
+#ifdef __unix__
+			std::unique_lock<std::mutex>	guard(lock);
+			notEmpty.wait(guard, [&]() -> bool {
+				return closed or not items.empty();
+			});
+#endif
+			if(items.empty())
+				return false;
+			item	= std::move(items.front());
+			items.pop_front();
+#ifdef __unix__
+			notFull.notify_one();
+#endif
+			return true;
+		}
+
+		void Close() {
+#ifdef __unix__
+			std::lock_guard<std::mutex>	guard(lock);
+			closed	= true;
+			notEmpty.notify_all();
+#else
+			closed	= true;
+#endif
+		}
+};
+
+/*
+	Bytes of jobs in flight. Acquire picks first request that fits into
+	what is left, request bigger than whole budget gets in only alone, so
+	small jobs run as wide as budget allows and huge ones one at a time.
+*/
+class MemoryBudget {
+	private:
+		size_t						limit;
+		size_t						used		= 0;
+		size_t						holders		= 0;
+#ifdef __unix__
+		std::mutex					lock;
+		std::condition_variable		released;
+#endif
+
+		inline bool Fits(size_t bytes) const {
+			return holders == 0 or used + bytes <= limit;
+		}
+
+	public:
+		MemoryBudget(size_t bytes)
+			: limit(bytes)
+		{}
+
+		//Waits until some of requests fits, takes it out of list and returns it
+		std::list<std::pair<size_t, size_t>>::iterator Acquire(std::list<std::pair<size_t, size_t>>& requests) {
+#ifdef __unix__
+			std::unique_lock<std::mutex>	guard(lock);
+#endif
+			auto	it	= requests.begin();
+			while(true) {
+				for(it = requests.begin(); it not_eq requests.end() and not Fits(it->second); ++it);
+				if(it not_eq requests.end())
+					break;
+#ifdef __unix__
+				released.wait(guard);
+#endif
+			}
+			used	+= it->second;
+			++holders;
+			return it;
+		}
+
+		void Release(size_t bytes) {
+#ifdef __unix__
+			std::lock_guard<std::mutex>	guard(lock);
+#endif
+			used	-= bytes;
+			--holders;
+#ifdef __unix__
+			released.notify_all();
+#endif
+		}
+};
+
+/*
+	Three stage batch pipeline:
+		reader	(1 thread)	- prefetches and parses input files
+		workers	(N threads)	- CPU heavy conversion
+		writer	(1 thread)	- serializes output to disk
+	Queues between stages are bounded, so at most ~2 * capacity jobs are
+	held in memory at once no matter how many files are queued. With
+	memory limit reader also admits jobs by their estimated bytes (held
+	from load to report), jobs that fit now overtake waiting big ones.
+*/
+template<typename Job>
+class Pipeline {
+	public:
+		//Stage returns false when job failed, failed jobs skip remaining stages
+		typedef std::function<bool(Job&)>	Stage;
+		//Called in writer thread for every job (failed or not), in completion order
+		typedef std::function<void(Job&, bool)>	Report;
+		//Estimated peak bytes of job
+		typedef std::function<size_t(Job&)>	Weight;
+
+	private:
+		size_t		workers;
+		size_t		capacity;
+		size_t		budget	= 0;
+		Weight		weight;
+
+	public:
+		Pipeline(size_t meshWorkers = 1, size_t queueCapacity = 2)
+			:	workers(meshWorkers < 1? 1: meshWorkers),
+				capacity(queueCapacity < 1? 1: queueCapacity)
+		{}
+
+		//Admits jobs only while sum of their weights stays under bytes
+		void Limit(size_t bytes, Weight jobBytes) {
+			budget	= bytes;
+			weight	= jobBytes;
+		}
+
+		//Returns number of failed jobs
+		size_t Run(vector<Job>& jobs, Stage load, Stage convert, Stage save, Report report) {
+			size_t	failed	= 0;
+#ifdef __unix__
+			BoundedQueue<std::pair<Job*, bool>>	loaded(capacity);
+			BoundedQueue<std::pair<Job*, bool>>	converted(capacity);
+
+			MemoryBudget	memory(budget);
+			std::thread		reader([&]() {
+				if(not weight) {
+					for(Job& job : jobs)
+						loaded.Push({&job, load(job)});
+					loaded.Close();
+					return;
+				}
+				//Job index, bytes
+				std::list<std::pair<size_t, size_t>>	pending;
+				for(size_t i = 0; i < jobs.size(); ++i)
+					pending.push_back({i, weight(jobs[i])});
+				while(not pending.empty()) {
+					auto	it	= memory.Acquire(pending);
+					Job&	job	= jobs[it->first];
+					pending.erase(it);
+					loaded.Push({&job, load(job)});
+				}
+				loaded.Close();
+			});
+
+			vector<std::thread>	pool;
+			std::mutex			poolLock;
+			size_t				running	= workers;
+			for(size_t i = 0; i < workers; ++i) {
+				pool.emplace_back([&]() {
+					std::pair<Job*, bool>	entry;
+					while(loaded.Pop(entry)) {
+						if(entry.second)
+							entry.second	= convert(*entry.first);
+						converted.Push(entry);
+					}
+					//Last worker out closes the writer queue
+					std::lock_guard<std::mutex>	guard(poolLock);
+					if(--running == 0)
+						converted.Close();
+				});
+			}
+
+			std::thread		writer([&]() {
+				std::pair<Job*, bool>	entry;
+				while(converted.Pop(entry)) {
+					if(entry.second)
+						entry.second	= save(*entry.first);
+					if(not entry.second)
+						++failed;
+					report(*entry.first, entry.second);
+					if(weight)
+						memory.Release(weight(*entry.first));
+				}
+			});
+
+			reader.join();
+			for(std::thread& t : pool)
+				t.join();
+			writer.join();
+#else
+			//No portable threads on MinGW, fallback to sequential stages
+			for(Job& job : jobs) {
+				bool	good	= load(job) and convert(job) and save(job);
+				if(not good)
+					++failed;
+				report(job, good);
+			}
+#endif
+			return failed;
+		}
+};
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef __SHELL__
+#define __SHELL__
+
+#include <vector>
+#include <cstdint>
+
+#include "VOX.h"
+
+/*
+	Bit per voxel occupancy of (part of) transformed grid, rows of 64
+	voxels along X. Shell voxels are solid ones with at least one empty
+	6-neighbour, whole row words are resolved with shifts and ANDs so
+	interior of solid models costs a few word operations per 64 voxels.
+	Voxels outside of given part count as empty.
+*/
+class ShellMask {
+	private:
+		vec<int>				size;
+		int						words	= 0;	//Per row
+		std::vector<uint64_t>	solid;
+		std::vector<uint64_t>	shell;
+
+		inline size_t Row(int y, int z) const {
+			return (size_t(y) + size_t(size.y) * z) * words;
+		}
+		//Solid word of row, empty outside of grid
+		inline uint64_t Word(int y, int z, int w) const {
+			if(y < 0 or z < 0 or y >= size.y or z >= size.z)
+				return 0;
+			return solid[Row(y, z) + w];
+		}
+
+	public:
+		ShellMask(const VOX::TransformedView& view, const vec<int>& from, const vec<int>& part)
+			:	size(part), words((part.x + 63) / 64)
+		{
+			solid.assign(size_t(words) * size.y * size.z, 0);
+			shell.assign(solid.size(), 0);
+
+			//Occupancy, every thread owns whole rows
+#ifdef __unix__
+			#pragma omp parallel for
+#endif
+			for(int z = 0; z < size.z; ++z) {
+				for(int y = 0; y < size.y; ++y) {
+					uint64_t*	row	= &solid[Row(y, z)];
+					for(int x = 0; x < size.x; ++x)
+						if(view.Get(from.x + x, from.y + y, from.z + z) not_eq 0)
+							row[x >> 6]	|= uint64_t(1) << (x & 63);
+				}
+			}
+
+			//Shell = solid and not (all 6 neighbours solid), padding bits are 0
+#ifdef __unix__
+			#pragma omp parallel for
+#endif
+			for(int z = 0; z < size.z; ++z) {
+				for(int y = 0; y < size.y; ++y) {
+					size_t	row	= Row(y, z);
+					for(int w = 0; w < words; ++w) {
+						uint64_t	bits	= solid[row + w];
+						if(bits == 0)
+							continue;
+						uint64_t	left	= (bits << 1) | (w > 0? solid[row + w - 1] >> 63: 0);
+						uint64_t	right	= (bits >> 1) | (w + 1 < words? solid[row + w + 1] << 63: 0);
+						shell[row + w]	= bits & ~(
+								left & right
+							&	Word(y - 1, z, w) & Word(y + 1, z, w)
+							&	Word(y, z - 1, w) & Word(y, z + 1, w)
+						);
+					}
+				}
+			}
+		}
+
+		inline bool Solid(int x, int y, int z) const {
+			if(x < 0 or x >= size.x)
+				return false;
+			return (Word(y, z, x >> 6) >> (x & 63)) & 1;
+		}
+
+		inline bool Shell(int x, int y, int z) const {
+			return (shell[Row(y, z) + (x >> 6)] >> (x & 63)) & 1;
+		}
+
+		//Bits of empty 6-neighbours: -X, +X, -Y, +Y, -Z, +Z
+		inline int EmptyFaces(int x, int y, int z) const {
+			return	(not Solid(x - 1, y, z))
+				|	(not Solid(x + 1, y, z)) << 1
+				|	(not Solid(x, y - 1, z)) << 2
+				|	(not Solid(x, y + 1, z)) << 3
+				|	(not Solid(x, y, z - 1)) << 4
+				|	(not Solid(x, y, z + 1)) << 5;
+		}
+};
+
+#endif
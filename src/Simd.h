@@ -0,0 +1,381 @@
+#ifndef __SIMD__
+#define __SIMD__
+
+#include <string>
+#include <cstdint>
+
+#if defined(__x86_64__) or defined(__i386__)
+	#define SIMD_X86
+	#include <immintrin.h>
+#endif
+
+typedef unsigned char	uchar;
+
+/*
+	Byte kernels of hot loops with runtime dispatch. Every kernel has
+	scalar, SSE4.1, AVX2 and AVX-512 (BW) version, vector ones are built
+	with target attributes, so base build needs no -m flags and one
+	binary uses best level of CPU (cpuid at startup) or one forced by
+	--simd. Kernels work on 0/1 or palette bytes only, results are same
+	bit for bit on every level. Neighbour tests of upscaling (ShellMask)
+	are not here, they already resolve 64 voxels per word operation and
+	are read only for shell voxels.
+*/
+class Simd {
+	public:
+		enum Level {
+			SCALAR,
+			SSE41,
+			AVX2,
+			AVX512
+		};
+
+		/*
+			Lattice points of row: out[j] (j = 0..count) is 1 when any of
+			4 rows is non zero at j - 1 or j (inside of grid), 0 otherwise
+		*/
+		static void	(*LatticeRow)(const uchar* const rows[4], int count, uchar* out);
+		/*
+			Marching cubes case bits (Bourke corner order) of count cubes,
+			lower/upper plane pointers are at first cube corner, next row
+			of corners is stride further
+		*/
+		static void	(*CubeRow)(const uchar* lower, const uchar* upper, int stride, int count, uchar* out);
+		//Solid voxels of 2x2 blocks: out[k] = non zero bytes 2k, 2k + 1 of 4 rows
+		static void	(*BlockCounts)(const uchar* const rows[4], int count, uchar* out);
+		//dst = reversed src, buffers must not overlap
+		static void	(*ReverseRow)(uchar* dst, const uchar* src, int count);
+
+		//Best level supported by CPU (and OS)
+		static Level Detect() {
+#ifdef SIMD_X86
+			__builtin_cpu_init();
+			if(__builtin_cpu_supports("avx512f") and __builtin_cpu_supports("avx512bw"))
+				return AVX512;
+			if(__builtin_cpu_supports("avx2"))
+				return AVX2;
+			if(__builtin_cpu_supports("sse4.1"))
+				return SSE41;
+#endif
+			return SCALAR;
+		}
+
+		static inline Level Active() {
+			return active;
+		}
+
+		static const char* Name(Level level) {
+			static const char*	names[]	= {"scalar", "sse4.1", "avx2", "avx512"};
+			return names[level];
+		}
+
+		//Name => level, false when unknown
+		static bool Parse(const std::string& name, Level& level) {
+			for(int l = SCALAR; l <= AVX512; ++l) {
+				if(name == Name(Level(l))) {
+					level	= Level(l);
+					return true;
+				}
+			}
+			return false;
+		}
+
+		//Switches kernels, false when CPU does not have level
+		static bool Select(Level level) {
+			if(level > Detect())
+				return false;
+			active		= level;
+			LatticeRow	= LatticeRowScalar;
+			CubeRow		= CubeRowScalar;
+			BlockCounts	= BlockCountsScalar;
+			ReverseRow	= ReverseRowScalar;
+#ifdef SIMD_X86
+			if(level == SSE41) {
+				LatticeRow	= LatticeRowSSE41;
+				CubeRow		= CubeRowSSE41;
+				BlockCounts	= BlockCountsSSE41;
+				ReverseRow	= ReverseRowSSE41;
+			} else if(level == AVX2) {
+				LatticeRow	= LatticeRowAVX2;
+				CubeRow		= CubeRowAVX2;
+				BlockCounts	= BlockCountsAVX2;
+				ReverseRow	= ReverseRowAVX2;
+			} else if(level == AVX512) {
+				LatticeRow	= LatticeRowAVX512;
+				CubeRow		= CubeRowAVX512;
+				BlockCounts	= BlockCountsAVX512;
+				ReverseRow	= ReverseRowAVX512;
+			}
+#endif
+			return true;
+		}
+
+	private:
+		static Level	active;
+
+		//Scalar kernels, also tails of vector ones
+		static inline uchar LatticeAt(const uchar* const rows[4], int count, int j) {
+			uchar	any	= 0;
+			for(int r = 0; r < 4; ++r)
+				any	|= (j > 0? rows[r][j - 1]: 0) | (j < count? rows[r][j]: 0);
+			return any not_eq 0;
+		}
+		static void LatticeRowScalar(const uchar* const rows[4], int count, uchar* out) {
+			for(int j = 0; j <= count; ++j)
+				out[j]	= LatticeAt(rows, count, j);
+		}
+
+		static inline uchar CubeAt(const uchar* lower, const uchar* upper, int stride, int i) {
+			return	lower[i]
+				|	lower[i + 1] << 1
+				|	lower[i + 1 + stride] << 2
+				|	lower[i + stride] << 3
+				|	upper[i] << 4
+				|	upper[i + 1] << 5
+				|	upper[i + 1 + stride] << 6
+				|	upper[i + stride] << 7;
+		}
+		static void CubeRowScalar(const uchar* lower, const uchar* upper, int stride, int count, uchar* out) {
+			for(int i = 0; i < count; ++i)
+				out[i]	= CubeAt(lower, upper, stride, i);
+		}
+
+		static inline uchar BlockAt(const uchar* const rows[4], int k) {
+			uchar	solid	= 0;
+			for(int r = 0; r < 4; ++r)
+				solid	+= (rows[r][2 * k] not_eq 0) + (rows[r][2 * k + 1] not_eq 0);
+			return solid;
+		}
+		static void BlockCountsScalar(const uchar* const rows[4], int count, uchar* out) {
+			for(int k = 0; k < count; ++k)
+				out[k]	= BlockAt(rows, k);
+		}
+
+		static void ReverseRowScalar(uchar* dst, const uchar* src, int count) {
+			for(int i = 0; i < count; ++i)
+				dst[i]	= src[count - i - 1];
+		}
+
+#ifdef SIMD_X86
+		//SSE4.1, 16 bytes per step
+		__attribute__((target("sse4.1")))
+		static void LatticeRowSSE41(const uchar* const rows[4], int count, uchar* out) {
+			const __m128i	zero	= _mm_setzero_si128();
+			const __m128i	one		= _mm_set1_epi8(1);
+			out[0]	= LatticeAt(rows, count, 0);
+			int		j		= 1;
+			for(; j + 16 <= count; j += 16) {
+				__m128i	any	= zero;
+				for(int r = 0; r < 4; ++r) {
+					any	= _mm_or_si128(any, _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[r] + j)));
+					any	= _mm_or_si128(any, _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[r] + j - 1)));
+				}
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + j), _mm_andnot_si128(_mm_cmpeq_epi8(any, zero), one));
+			}
+			for(; j <= count; ++j)
+				out[j]	= LatticeAt(rows, count, j);
+		}
+
+		__attribute__((target("sse4.1")))
+		static void CubeRowSSE41(const uchar* lower, const uchar* upper, int stride, int count, uchar* out) {
+			//Corner bytes are 0/1, 16 bit shifts never carry into next byte
+			const int	offsets[4]	= {0, 1, 1 + stride, stride};
+			int			i			= 0;
+			for(; i + 16 <= count; i += 16) {
+				__m128i	bits	= _mm_setzero_si128();
+				for(int c = 0; c < 4; ++c) {
+					__m128i	low		= _mm_loadu_si128(reinterpret_cast<const __m128i*>(lower + i + offsets[c]));
+					__m128i	high	= _mm_loadu_si128(reinterpret_cast<const __m128i*>(upper + i + offsets[c]));
+					bits	= _mm_or_si128(bits, _mm_sll_epi16(low, _mm_cvtsi32_si128(c)));
+					bits	= _mm_or_si128(bits, _mm_sll_epi16(high, _mm_cvtsi32_si128(c + 4)));
+				}
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), bits);
+			}
+			for(; i < count; ++i)
+				out[i]	= CubeAt(lower, upper, stride, i);
+		}
+
+		__attribute__((target("sse4.1")))
+		static void BlockCountsSSE41(const uchar* const rows[4], int count, uchar* out) {
+			const __m128i	zero	= _mm_setzero_si128();
+			const __m128i	one		= _mm_set1_epi8(1);
+			int				k		= 0;
+			for(; k + 8 <= count; k += 8) {
+				__m128i	sum	= zero;
+				for(int r = 0; r < 4; ++r) {
+					__m128i	bytes	= _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[r] + 2 * k));
+					sum	= _mm_add_epi8(sum, _mm_andnot_si128(_mm_cmpeq_epi8(bytes, zero), one));
+				}
+				//Neighbour byte pairs => 16 bit lanes => bytes
+				__m128i	pairs	= _mm_maddubs_epi16(sum, one);
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(out + k), _mm_packus_epi16(pairs, pairs));
+			}
+			for(; k < count; ++k)
+				out[k]	= BlockAt(rows, k);
+		}
+
+		__attribute__((target("sse4.1")))
+		static void ReverseRowSSE41(uchar* dst, const uchar* src, int count) {
+			const __m128i	reverse	= _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+			int				i		= 0;
+			for(; i + 16 <= count; i += 16) {
+				__m128i	block	= _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + count - i - 16));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_shuffle_epi8(block, reverse));
+			}
+			for(; i < count; ++i)
+				dst[i]	= src[count - i - 1];
+		}
+
+		//AVX2, 32 bytes per step
+		__attribute__((target("avx2")))
+		static void LatticeRowAVX2(const uchar* const rows[4], int count, uchar* out) {
+			const __m256i	zero	= _mm256_setzero_si256();
+			const __m256i	one		= _mm256_set1_epi8(1);
+			out[0]	= LatticeAt(rows, count, 0);
+			int		j		= 1;
+			for(; j + 32 <= count; j += 32) {
+				__m256i	any	= zero;
+				for(int r = 0; r < 4; ++r) {
+					any	= _mm256_or_si256(any, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[r] + j)));
+					any	= _mm256_or_si256(any, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[r] + j - 1)));
+				}
+				_mm256_storeu_si256(
+					reinterpret_cast<__m256i*>(out + j), _mm256_andnot_si256(_mm256_cmpeq_epi8(any, zero), one)
+				);
+			}
+			for(; j <= count; ++j)
+				out[j]	= LatticeAt(rows, count, j);
+		}
+
+		__attribute__((target("avx2")))
+		static void CubeRowAVX2(const uchar* lower, const uchar* upper, int stride, int count, uchar* out) {
+			const int	offsets[4]	= {0, 1, 1 + stride, stride};
+			int			i			= 0;
+			for(; i + 32 <= count; i += 32) {
+				__m256i	bits	= _mm256_setzero_si256();
+				for(int c = 0; c < 4; ++c) {
+					__m256i	low		= _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lower + i + offsets[c]));
+					__m256i	high	= _mm256_loadu_si256(reinterpret_cast<const __m256i*>(upper + i + offsets[c]));
+					bits	= _mm256_or_si256(bits, _mm256_sll_epi16(low, _mm_cvtsi32_si128(c)));
+					bits	= _mm256_or_si256(bits, _mm256_sll_epi16(high, _mm_cvtsi32_si128(c + 4)));
+				}
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), bits);
+			}
+			for(; i < count; ++i)
+				out[i]	= CubeAt(lower, upper, stride, i);
+		}
+
+		__attribute__((target("avx2")))
+		static void BlockCountsAVX2(const uchar* const rows[4], int count, uchar* out) {
+			const __m256i	zero	= _mm256_setzero_si256();
+			const __m256i	one		= _mm256_set1_epi8(1);
+			int				k		= 0;
+			for(; k + 16 <= count; k += 16) {
+				__m256i	sum	= zero;
+				for(int r = 0; r < 4; ++r) {
+					__m256i	bytes	= _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[r] + 2 * k));
+					sum	= _mm256_add_epi8(sum, _mm256_andnot_si256(_mm256_cmpeq_epi8(bytes, zero), one));
+				}
+				__m256i	pairs	= _mm256_maddubs_epi16(sum, one);
+				_mm_storeu_si128(
+					reinterpret_cast<__m128i*>(out + k),
+					_mm_packus_epi16(_mm256_castsi256_si128(pairs), _mm256_extracti128_si256(pairs, 1))
+				);
+			}
+			for(; k < count; ++k)
+				out[k]	= BlockAt(rows, k);
+		}
+
+		__attribute__((target("avx2")))
+		static void ReverseRowAVX2(uchar* dst, const uchar* src, int count) {
+			//Bytes reversed within 128 bit lanes, then lanes swapped
+			const __m256i	reverse	= _mm256_setr_epi8(
+				15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+				15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0
+			);
+			int				i		= 0;
+			for(; i + 32 <= count; i += 32) {
+				__m256i	block	= _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + count - i - 32));
+				block	= _mm256_shuffle_epi8(block, reverse);
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_permute2x128_si256(block, block, 1));
+			}
+			for(; i < count; ++i)
+				dst[i]	= src[count - i - 1];
+		}
+
+		//AVX-512 (F + BW), 64 bytes per step, maskz forms avoid undefined sources (GCC warnings)
+		__attribute__((target("avx512f,avx512bw")))
+		static void LatticeRowAVX512(const uchar* const rows[4], int count, uchar* out) {
+			const __m512i	one		= _mm512_set1_epi8(1);
+			out[0]	= LatticeAt(rows, count, 0);
+			int		j		= 1;
+			for(; j + 64 <= count; j += 64) {
+				__m512i	any	= _mm512_setzero_si512();
+				for(int r = 0; r < 4; ++r) {
+					any	= _mm512_or_si512(any, _mm512_loadu_si512(rows[r] + j));
+					any	= _mm512_or_si512(any, _mm512_loadu_si512(rows[r] + j - 1));
+				}
+				_mm512_storeu_si512(out + j, _mm512_maskz_mov_epi8(_mm512_test_epi8_mask(any, any), one));
+			}
+			for(; j <= count; ++j)
+				out[j]	= LatticeAt(rows, count, j);
+		}
+
+		__attribute__((target("avx512f,avx512bw")))
+		static void CubeRowAVX512(const uchar* lower, const uchar* upper, int stride, int count, uchar* out) {
+			const int	offsets[4]	= {0, 1, 1 + stride, stride};
+			int			i			= 0;
+			for(; i + 64 <= count; i += 64) {
+				__m512i	bits	= _mm512_setzero_si512();
+				for(int c = 0; c < 4; ++c) {
+					__m512i	low		= _mm512_loadu_si512(lower + i + offsets[c]);
+					__m512i	high	= _mm512_loadu_si512(upper + i + offsets[c]);
+					bits	= _mm512_or_si512(bits, _mm512_sll_epi16(low, _mm_cvtsi32_si128(c)));
+					bits	= _mm512_or_si512(bits, _mm512_sll_epi16(high, _mm_cvtsi32_si128(c + 4)));
+				}
+				_mm512_storeu_si512(out + i, bits);
+			}
+			for(; i < count; ++i)
+				out[i]	= CubeAt(lower, upper, stride, i);
+		}
+
+		__attribute__((target("avx512f,avx512bw")))
+		static void BlockCountsAVX512(const uchar* const rows[4], int count, uchar* out) {
+			const __m512i	one		= _mm512_set1_epi8(1);
+			int				k		= 0;
+			for(; k + 32 <= count; k += 32) {
+				__m512i	sum	= _mm512_setzero_si512();
+				for(int r = 0; r < 4; ++r) {
+					__m512i	bytes	= _mm512_loadu_si512(rows[r] + 2 * k);
+					sum	= _mm512_add_epi8(sum, _mm512_maskz_mov_epi8(_mm512_test_epi8_mask(bytes, bytes), one));
+				}
+				__m512i	pairs	= _mm512_maddubs_epi16(sum, one);
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + k), _mm512_maskz_cvtepi16_epi8(0xFFFFFFFF, pairs));
+			}
+			for(; k < count; ++k)
+				out[k]	= BlockAt(rows, k);
+		}
+
+		__attribute__((target("avx512f,avx512bw")))
+		static void ReverseRowAVX512(uchar* dst, const uchar* src, int count) {
+			//Bytes reversed within 128 bit lanes, then order of lanes reversed
+			const long long	low		= 0x08090A0B0C0D0E0F;
+			const long long	high	= 0x0001020304050607;
+			const __m512i	reverse	= _mm512_set_epi64(high, low, high, low, high, low, high, low);
+			int				i		= 0;
+			for(; i + 64 <= count; i += 64) {
+				__m512i	block	= _mm512_shuffle_epi8(_mm512_loadu_si512(src + count - i - 64), reverse);
+				_mm512_storeu_si512(dst + i, _mm512_maskz_shuffle_i64x2(0xFF, block, block, 0x1B));
+			}
+			for(; i < count; ++i)
+				dst[i]	= src[count - i - 1];
+		}
+#endif
+};
+inline Simd::Level	Simd::active						= Simd::SCALAR;
+inline void			(*Simd::LatticeRow)(const uchar* const[4], int, uchar*)				= Simd::LatticeRowScalar;
+inline void			(*Simd::CubeRow)(const uchar*, const uchar*, int, int, uchar*)		= Simd::CubeRowScalar;
+inline void			(*Simd::BlockCounts)(const uchar* const[4], int, uchar*)			= Simd::BlockCountsScalar;
+inline void			(*Simd::ReverseRow)(uchar*, const uchar*, int)						= Simd::ReverseRowScalar;
+
+#endif
@@ -5,6 +5,14 @@
 #include <fstream>
 #include <cstring>
 #include <cmath>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <new>
+
+#include "Arena.h"
+#include "Simd.h"
 
 // #include <xmmintrin.h>
 // #include <smmintrin.h>
@@ -29,15 +37,16 @@ class vec {
 			T		raw[4];
 		};
 
-		vec(T R = 0, T G = 0, T B = 0, T A = 0)
+		constexpr vec(T R = 0, T G = 0, T B = 0, T A = 0)
 			:	r(R), g(G), b(B), a(A)
 		{}
-		vec(const vec<T>& org)
+		constexpr vec(const vec<T>& org)
 			:	r(org.r), g(org.g), b(org.b), a(org.a)
 		{}
+		vec<T>& operator=(const vec<T>& org) = default;
 
-		~vec()
-		{}
+		//Trivial destructor keeps vec literal type (constexpr tables)
+		~vec() = default;
 
 		//Methods
 		vec<T>& Set(T R, T G, T B, T A) {
@@ -169,16 +178,116 @@ inline vec<K> operator*(const vec<T>& lhs, K rhs) {
 	return vec<K>(lhs.z * rhs, lhs.y * rhs, lhs.x * rhs);
 }
 
+/*
+	Axis permutation with optional mirroring, axis i of transformed grid
+	is axis[i] of source grid, reversed when mirror[i]. Transforms compose
+	so flips and Magica => Unity rotation are applied in one pass.
+*/
+class AxisTransform {
+	public:
+		int		axis[3]		= {0, 1, 2};
+		bool	mirror[3]	= {false, false, false};
+
+		static AxisTransform Flip(bool x, bool y, bool z) {
+			AxisTransform	transform;
+			transform.mirror[0]	= x;
+			transform.mirror[1]	= y;
+			transform.mirror[2]	= z;
+			return transform;
+		}
+
+		//Magica is Z up, Unity is Y up: (x, y, z) <= (x, SizeY - z - 1, y)
+		static AxisTransform MagicaToUnity() {
+			AxisTransform	transform;
+			transform.axis[1]	= 2;
+			transform.axis[2]	= 1;
+			transform.mirror[2]	= true;
+			return transform;
+		}
+
+		//Applies this transform first and then next one
+		AxisTransform Then(const AxisTransform& next) const {
+			AxisTransform	result;
+			for(int i = 0; i < 3; ++i) {
+				result.axis[i]		= axis[next.axis[i]];
+				result.mirror[i]	= mirror[next.axis[i]] not_eq next.mirror[i];
+			}
+			return result;
+		}
+
+		bool IsIdentity() const {
+			return	axis[0] == 0 and axis[1] == 1 and axis[2] == 2
+				and	not mirror[0] and not mirror[1] and not mirror[2];
+		}
+
+		vec<int> Size(const vec<int>& source) const {
+			return vec<int>(source.raw[axis[0]], source.raw[axis[1]], source.raw[axis[2]]);
+		}
+};
+
 class VOX {
+	public:
+		/*
+			Memory order of voxels:
+				LINEAR	- x + X * (y + Y * z), rows along X
+				TILED	- 4x4x4 bricks (one 64B cache line each) stored in
+						  linear brick order, all 26 neighbours of a voxel lie
+						  in at most 8 bricks so stencils touch few lines
+		*/
+		enum Layout {
+			LINEAR	= 0,
+			TILED	= 2		//log2 of brick edge
+		};
+
+		class Cursor;
+
+		/*
+			Render material of palette index (MATL chunk, or legacy MATT),
+			properties are 0..1 and only those of its type are set:
+				METAL	- metal, rough
+				GLASS	- trans, rough, ior
+				EMIT	- emit (light has color of palette)
+				BLEND	- all of them
+				MEDIA	- trans (clouds, smoke)
+		*/
+		struct Material {
+			enum Type : uchar {
+				DIFFUSE, METAL, GLASS, EMIT, BLEND, MEDIA
+			};
+			Type	type	= DIFFUSE;
+			float	metal	= 0.0f;
+			float	rough	= 0.1f;
+			float	trans	= 0.0f;
+			float	ior		= 1.3f;
+			float	emit	= 0.0f;
+
+			//Same look, every diffuse material is plain color
+			bool operator==(const Material& other) const {
+				return	type == other.type and (
+							type == DIFFUSE or (
+								metal == other.metal and rough == other.rough and trans == other.trans
+							and	ior == other.ior and emit == other.emit
+							)
+						);
+			}
+		};
+
 	private:
 		vec<int>	size;
 		vec<uchar>	palette[256];
+		Material	materials[256];
 		uchar*		voxel;
+		size_t		capacity		= 0;
+		size_t		storage			= 0;	//Used bytes, brick padding included
+
+		Layout				layout	= LINEAR;
+		//Per axis offsets of coordinates -1..size, outer ones are == storage
+		std::vector<size_t>	offsets[3];
 
 		int			version			= 0;
 	public:
-		VOX()
-			: voxel(nullptr)
+		VOX(Layout setLayout = LINEAR)
+			: voxel(nullptr), layout(setLayout)
 		{}
 		VOX(int sizeX, int sizeY, int sizeZ)
 			: voxel(nullptr)
@@ -198,7 +307,20 @@ class VOX {
 		}
 		~VOX() {
 			if(voxel not_eq nullptr)
-				delete[]	voxel;
+				ScratchMemory::Free(voxel);
+		}
+
+		//Reuses buffer when it is big enough, clear == false leaves old content
+		void Resize(vec<int> setSize, bool clear = true) {
+			Alloc(setSize.x, setSize.y, setSize.z, clear);
+		}
+
+		//Takes effect with next Resize/LoadFile (pooled grids)
+		inline void SetLayout(Layout setLayout) {
+			layout	= setLayout;
+		}
+		inline Layout GetLayout() {
+			return layout;
 		}
 		
 		inline int SizeX() {
@@ -214,22 +336,143 @@ class VOX {
 			return size;
 		}
 
-		inline bool LoadFile(string path) {
-			return LoadFile(path.c_str());
+		//Transform (flips, axis swaps) is applied to every voxel while decoding
+		inline bool LoadFile(string path, const AxisTransform& transform = AxisTransform()) {
+			return LoadFile(path.c_str(), transform);
 		}
-		bool LoadFile(const char* path) {
+		bool LoadFile(const char* path, const AxisTransform& transform = AxisTransform()) {
 			ifstream	hFile(path, std::ios::in bitor std::ios::binary);
 
 			if(hFile.fail()) {
 				cerr	<< "[VOX] Failed to open file!" << endl;
 				return false;
 			}
-			bool success = ReadFile(hFile);
+			bool success = ReadFile(hFile, transform);
 
 			hFile.close();
 			return success;
 		}
 
+		//Summary of file chunks, see Inspect
+		struct Header {
+			vec<int>	size;				//Of last model (converted one), file axis order
+			size_t		voxels		= 0;	//Of last model
+			int			models		= 0;
+			uint64_t	paletteHash	= 0;	//FNV-1a of used 256 RGBA colors
+		};
+
+		/*
+			Reads only chunk headers, SIZE and voxel count of XYZI (voxel
+			data is skipped) and palette, grid is not allocated.
+		*/
+		inline bool Inspect(string path, Header& header) {
+			return Inspect(path.c_str(), header);
+		}
+		bool Inspect(const char* path, Header& header) {
+			ifstream	hFile(path, std::ios::in bitor std::ios::binary);
+			int			magic[2]	= {0, 0};
+			hFile.read(reinterpret_cast<char*>(magic), 8);
+			if(hFile.fail() or magic[0] not_eq ID_VOX or magic[1] not_eq MV_VERSION)
+				return false;
+
+			Chunk	mainChunk;
+			mainChunk.ReadFromFile(hFile);
+			if(hFile.fail() or mainChunk.id not_eq Chunk::Type::MAIN)
+				return false;
+			hFile.seekg(static_cast<long int>(hFile.tellg()) + mainChunk.contentSize);
+
+			bool	customPalette	= false;
+			header	= Header();
+			while(hFile.tellg() < mainChunk.end) {
+				Chunk	childrenChunk;
+				childrenChunk.ReadFromFile(hFile);
+				if(hFile.fail())
+					return false;
+
+				if(childrenChunk.id == Chunk::Type::SIZE) {
+					hFile.read(reinterpret_cast<char*>(&header.size), 12);
+					++header.models;
+				} else if(childrenChunk.id == Chunk::Type::XYZI) {
+					int	count	= 0;
+					hFile.read(reinterpret_cast<char*>(&count), 4);
+					header.voxels	= std::max(count, 0);
+				} else if(childrenChunk.id == Chunk::Type::RGBA) {
+					memset(reinterpret_cast<void*>(palette), 0, sizeof(vec<uchar>) * 256);
+					hFile.read(reinterpret_cast<char*>(palette), sizeof(vec<uchar>) * 255);
+					customPalette	= true;
+				}
+				if(hFile.fail())
+					return false;
+				if(childrenChunk.end >= mainChunk.end)
+					break;
+				hFile.seekg(childrenChunk.end);
+			}
+			if(not customPalette)
+				SetDefaultPalette();
+
+			header.paletteHash	= 0xCBF29CE484222325ull;
+			for(const uchar* byte = palette[0].raw; byte < palette[0].raw + sizeof(palette); ++byte)
+				header.paletteHash	= (header.paletteHash ^ *byte) * 0x100000001B3ull;
+			return header.models > 0;
+		}
+
+		/*
+			FNV-1a of decoded model: size, voxels row by row (same for any
+			layout), palette and materials. Files that differ only in
+			chunk layout or voxel order get same hash.
+		*/
+		uint64_t ContentHash() {
+			uint64_t	hash	= 0xCBF29CE484222325ull;
+			auto		add		= [&hash](const void* data, size_t bytes) {
+				const uchar*	byte	= static_cast<const uchar*>(data);
+				for(size_t i = 0; i < bytes; ++i)
+					hash	= (hash ^ byte[i]) * 0x100000001B3ull;
+			};
+
+			int		dimensions[3]	= {size.x, size.y, size.z};
+			add(dimensions, sizeof(dimensions));
+			std::vector<uchar>	row(size.x);
+			for(int z = 0; z < size.z; ++z) {
+				for(int y = 0; y < size.y; ++y) {
+					for(int x = 0; x < size.x; ++x)
+						row[x]	= GetVoxelRaw(x, y, z);
+					add(row.data(), row.size());
+				}
+			}
+
+			//Last color is never read from file
+			add(palette, sizeof(vec<uchar>) * 255);
+			for(const Material& material : materials) {
+				float	values[5]	= {material.metal, material.rough, material.trans, material.ior, material.emit};
+				add(&material.type, 1);
+				add(values, sizeof(values));
+			}
+			return hash;
+		}
+
+		//Same content as ContentHash covers, exact check of hash match
+		bool SameContent(VOX& other) {
+			if(size.x not_eq other.size.x or size.y not_eq other.size.y or size.z not_eq other.size.z)
+				return false;
+			if(memcmp(palette, other.palette, sizeof(vec<uchar>) * 255) not_eq 0)
+				return false;
+			for(int i = 0; i < 256; ++i) {
+				const Material&	a	= materials[i];
+				const Material&	b	= other.materials[i];
+				float	values[2][5]	= {
+					{a.metal, a.rough, a.trans, a.ior, a.emit}, {b.metal, b.rough, b.trans, b.ior, b.emit}
+				};
+				if(a.type not_eq b.type or memcmp(values[0], values[1], sizeof(values[0])) not_eq 0)
+					return false;
+			}
+			for(int z = 0; z < size.z; ++z)
+				for(int y = 0; y < size.y; ++y)
+					for(int x = 0; x < size.x; ++x)
+						if(GetVoxelRaw(x, y, z) not_eq other.GetVoxelRaw(x, y, z))
+							return false;
+			return true;
+		}
+
 		inline bool SaveFile(string path) {
 			return SaveFile(path.c_str());
 		}
@@ -259,7 +502,7 @@ class VOX {
 			}
 		}
 		inline void SetVoxelRaw(int x, int y, int z, uchar colorPalleteIndex) {
-			voxel[x + size.x * (y + size.y * z)] 	= colorPalleteIndex;
+			voxel[Index(x, y, z)] 	= colorPalleteIndex;
 		}
 		inline void SetVoxelRaw(vec<int> pos, uchar colorPalleteIndex) {
 			SetVoxelRaw(pos.x, pos.y, pos.z, colorPalleteIndex);
@@ -278,77 +521,450 @@ class VOX {
 			return GetVoxel(pos.x, pos.y, pos.z);
 		}
 		inline uchar GetVoxelRaw(int x, int y, int z) {
-			return voxel[x + size.x * (y + size.y * z)];
+			return voxel[Index(x, y, z)];
 		}
 		inline uchar GetVoxelRaw(vec<int> pos) {
 			return GetVoxelRaw(pos.x, pos.y, pos.z);
 		}
+		//Bytes held by grid (allocated storage and tiled offsets)
+		inline size_t Footprint() const {
+			return capacity + (offsets[0].capacity() + offsets[1].capacity() + offsets[2].capacity()) * sizeof(size_t);
+		}
+		//Row along X of LINEAR grid, TILED rows are not contiguous (nullptr)
+		inline const uchar* LinearRow(int y, int z) const {
+			return layout == LINEAR? voxel + Index(0, y, z): nullptr;
+		}
+
+		//Storage index of voxel, only TILED one is valid for -1..size (outer ones are >= storage)
+		inline size_t Index(int x, int y, int z) const {
+			if(layout == LINEAR)
+				return x + size_t(size.x) * (y + size_t(size.y) * z);
+			return offsets[0][x + 1] + offsets[1][y + 1] + offsets[2][z + 1];
+		}
+
+		/*
+			Position in grid with cheap access to its 26 neighbours, sums
+			three cached axis offsets instead of recomputing whole index.
+			Neighbours outside of grid read as empty.
+		*/
+		class Cursor {
+			public:
+				int		x, y, z;
+				size_t	index;
+
+				inline uchar Get() const {
+					return vox->voxel[index];
+				}
+				//dx, dy, dz in -1..1
+				inline uchar Neighbour(int dx, int dy, int dz) const {
+					size_t	i	= axis[0][dx] + axis[1][dy] + axis[2][dz];
+					return i < vox->storage? vox->voxel[i]: 0;
+				}
+
+			private:
+				friend class VOX;
+
+				const VOX*		vox;
+				const size_t*	axis[3];
+
+				Cursor(const VOX* grid, int X, int Y, int Z)
+					:	x(X), y(Y), z(Z), vox(grid)
+				{
+					axis[0]	= &grid->offsets[0][X + 1];
+					axis[1]	= &grid->offsets[1][Y + 1];
+					axis[2]	= &grid->offsets[2][Z + 1];
+					index	= axis[0][0] + axis[1][0] + axis[2][0];
+				}
+		};
+
+		inline Cursor At(int x, int y, int z) const {
+			return Cursor(this, x, y, z);
+		}
+
+		/*
+			Visits every voxel in memory order (brick by brick for TILED),
+			layers of bricks are spread over threads. visit(const Cursor&)
+			must be safe to call concurrently.
+		*/
+		template<typename Visit>
+		void ForEachVoxel(Visit visit) const {
+			int		brick	= 1 << layout;
+			int		layers	= (size.z + brick - 1) / brick;
+#ifdef __unix__
+			#pragma omp parallel for schedule(dynamic)
+#endif
+			for(int bz = 0; bz < layers; ++bz) {
+				int	endZ	= std::min(size.z, (bz + 1) * brick);
+				for(int by = 0; by < size.y; by += brick) {
+					int	endY	= std::min(size.y, by + brick);
+					for(int bx = 0; bx < size.x; bx += brick) {
+						int	endX	= std::min(size.x, bx + brick);
+						for(int z = bz * brick; z < endZ; ++z)
+							for(int y = by; y < endY; ++y)
+								for(int x = bx; x < endX; ++x)
+									visit(At(x, y, z));
+					}
+				}
+			}
+		}
+
+		/*
+			Transformed grid read in place, no copy is made. Transformed
+			coordinates -1..size are valid, outside ones read as empty.
+		*/
+		class TransformedView {
+			public:
+				TransformedView(const VOX& source, const AxisTransform& transform)
+					:	grid(source), size(transform.Size(source.size))
+				{
+					for(int i = 0; i < 3; ++i) {
+						int		from	= transform.axis[i];
+						int		count	= size.raw[i];
+						offsets[i].resize(count + 2);
+						for(int c = -1; c <= count; ++c) {
+							int	s	= transform.mirror[i]? count - c - 1: c;
+							offsets[i][c + 1]	= grid.offsets[from][s + 1];
+						}
+					}
+				}
+
+				inline vec<int> Size() const {
+					return size;
+				}
+				inline uchar Get(int x, int y, int z) const {
+					size_t	i	= offsets[0][x + 1] + offsets[1][y + 1] + offsets[2][z + 1];
+					return i < grid.storage? grid.voxel[i]: 0;
+				}
+
+			private:
+				const VOX&			grid;
+				vec<int>			size;
+				std::vector<size_t>	offsets[3];
+		};
 
 		inline vec<uchar>& AccessPalleteColor(uchar index) {
 			return palette[index];
 		}
+		inline Material& AccessMaterial(uchar index) {
+			return materials[index];
+		}
 
+		/*
+			Mirrors grid in place in single pass. Every voxel is swapped
+			with its mirror exactly once (by the one with lower index), so
+			threads never touch same voxel. Linear grids swap whole rows,
+			X flip reverses them 16 bytes at once.
+		*/
 		void Flip(bool doX, bool doY, bool doZ) {
-			uchar	current = 0;
-			uchar	mirror	= 0;
-			if(doX) {
+			if(not doX and not doY and not doZ)
+				return;
+
+			if(layout not_eq LINEAR) {
 #ifdef __unix__
 				#pragma omp parallel for
 #endif
 				for(int z = 0; z < size.z; ++z) {
 					for(int y = 0; y < size.y; ++y) {
-						int	halfX	= floor(size.x * 0.5f);
-						for(int x = 0; x < halfX; ++x) {
-							current	= GetVoxelRaw(x, y, z);
-							mirror	= GetVoxelRaw(size.x - x - 1, y, z);
-							SetVoxelRaw(x, y, z, mirror);
-							SetVoxelRaw(size.x - x - 1, y, z, current);
-						}	
+						for(int x = 0; x < size.x; ++x) {
+							size_t	a	= Index(x, y, z);
+							size_t	b	= Index(
+								doX? size.x - x - 1: x, doY? size.y - y - 1: y, doZ? size.z - z - 1: z
+							);
+							if(a < b)
+								std::swap(voxel[a], voxel[b]);
+						}
 					}
 				}
+				return;
 			}
-			if(doY) {
+
+			size_t	rows	= size_t(size.y) * size.z;
 #ifdef __unix__
-				#pragma omp parallel for
+			#pragma omp parallel
 #endif
-				for(int z = 0; z < size.z; ++z) {
-					for(int x = 0; x < size.x; ++x) {
-						int	halfY	= floor(size.y * 0.5f);
-						for(int y = 0; y < halfY; ++y) {
-							current	= GetVoxelRaw(x, y, z);
-							mirror	= GetVoxelRaw(x, size.y - y - 1, z);
-							SetVoxelRaw(x, y, z, mirror);
-							SetVoxelRaw(x, size.y - y - 1, z, current);
-						}	
+			{
+				std::vector<uchar>	row(size.x);
+#ifdef __unix__
+				#pragma omp for
+#endif
+				for(long long r = 0; r < (long long)rows; ++r) {
+					int		y		= r % size.y;
+					int		z		= r / size.y;
+					size_t	m		= size_t(doY? size.y - y - 1: y) + size_t(size.y) * (doZ? size.z - z - 1: z);
+					if(size_t(r) > m)
+						continue;
+
+					uchar*	a	= voxel + r * size.x;
+					uchar*	b	= voxel + m * size.x;
+					if(not doX) {
+						if(a not_eq b)
+							std::swap_ranges(a, a + size.x, b);
+						continue;
 					}
+					Simd::ReverseRow(row.data(), a, size.x);
+					if(a not_eq b)
+						Simd::ReverseRow(a, b, size.x);
+					memcpy(b, row.data(), size.x);
 				}
 			}
-			if(doZ) {
+		}
+
+		/*
+			Fills sealed cavities (empty space not reachable from outside
+			of grid) with color of their wall, so inner surfaces are never
+			meshed. Exterior grows through 26-neighbours, every cube that
+			touches it keeps its surface. Works on bit rows along X: row is
+			seeded from 3x3 rows around it and spread along X by word-wide
+			fills, forward/backward sweeps repeat until nothing changes.
+			Returns number of filled voxels.
+		*/
+		size_t FillCavities() {
+			int			words	= (size.x + 63) / 64;
+			long long	rows	= (long long)size.y * size.z;
+			if(words == 0 or rows == 0)
+				return 0;
+
+			std::vector<uint64_t>	empty(rows * words, 0);
+			std::vector<uint64_t>	outside(rows * words, 0);
 #ifdef __unix__
-				#pragma omp parallel for
+			#pragma omp parallel for
+#endif
+			for(long long r = 0; r < rows; ++r) {
+				uint64_t*	row	= &empty[r * words];
+				for(int x = 0; x < size.x; ++x)
+					if(voxel[Index(x, r % size.y, r / size.y)] == 0)
+						row[x >> 6]	|= uint64_t(1) << (x & 63);
+			}
+
+			std::vector<uint64_t>	seed(words);
+			bool					changed	= true;
+			for(int sweep = 0; changed; ++sweep) {
+				changed	= false;
+				for(long long i = 0; i < rows; ++i) {
+					long long	r	= sweep % 2 == 0? i: rows - 1 - i;
+					int			y	= r % size.y;
+					int			z	= r / size.y;
+					const uint64_t*	open	= &empty[r * words];
+					uint64_t*		reached	= &outside[r * words];
+
+					//Rows on grid border touch padding everywhere, others take 3x3 rows dilated along X
+					if(y == 0 or z == 0 or y == size.y - 1 or z == size.z - 1) {
+						std::fill(seed.begin(), seed.end(), ~uint64_t(0));
+					} else {
+						std::fill(seed.begin(), seed.end(), 0);
+						for(int dz = -1; dz <= 1; ++dz) {
+							const uint64_t*	near	= &outside[(r + (long long)dz * size.y - 1) * words];
+							for(int w = 0; w < words * 3; ++w)
+								seed[w % words]	|= near[w];
+						}
+						uint64_t	previous	= 0;
+						for(int w = 0; w < words; ++w) {
+							uint64_t	bits	= seed[w];
+							seed[w]	= bits | (bits << 1) | (bits >> 1) | (previous >> 63)
+									| (w + 1 < words? seed[w + 1] << 63: 0);
+							previous	= bits;
+						}
+						seed[0]				|= 1;
+						seed[(size.x - 1) >> 6]	|= uint64_t(1) << ((size.x - 1) & 63);
+					}
+
+					//Spread seeds over empty runs of row, up then down
+					uint64_t	carry	= 0;
+					for(int w = 0; w < words; ++w) {
+						seed[w]	= FillUp((seed[w] | carry) & open[w], open[w]);
+						carry	= seed[w] >> 63;
+					}
+					carry	= 0;
+					for(int w = words - 1; w >= 0; --w) {
+						seed[w]	= FillDown(seed[w] | (carry << 63 & open[w]), open[w]);
+						carry	= seed[w] & 1;
+					}
+					for(int w = 0; w < words; ++w) {
+						if((seed[w] | reached[w]) not_eq reached[w]) {
+							reached[w]	|= seed[w];
+							changed		= true;
+						}
+					}
+				}
+			}
+
+			//Cavity run starts right after wall voxel (x == 0 is always exterior)
+			size_t	filled	= 0;
+#ifdef __unix__
+			#pragma omp parallel for reduction(+:filled)
 #endif
+			for(long long r = 0; r < rows; ++r) {
+				int		y		= r % size.y;
+				int		z		= r / size.y;
+				uchar	wall	= 0;
 				for(int x = 0; x < size.x; ++x) {
-					for(int y = 0; y < size.y; ++y) {
-						int	halfZ	= floor(size.z * 0.5f);
-						for(int z = 0; z < halfZ; ++z) {
-							current	= GetVoxelRaw(x, y, z);
-							mirror	= GetVoxelRaw(x, y, size.z - z - 1);
-							SetVoxelRaw(x, y, z, mirror);
-							SetVoxelRaw(x, y, size.z - z - 1, current);
-						}	
+					uint64_t	bit	= uint64_t(1) << (x & 63);
+					size_t		at	= Index(x, y, z);
+					if(not (empty[r * words + (x >> 6)] & bit)) {
+						wall	= voxel[at];
+					} else if(not (outside[r * words + (x >> 6)] & bit)) {
+						voxel[at]	= wall;
+						++filled;
+					}
+				}
+			}
+			return filled;
+		}
+
+		/*
+			Next mip level: every 2x2x2 block becomes one voxel, solid when
+			at least threshold of its voxels (those inside of grid) are,
+			with color most of them have (lower index on tie). Linear grids
+			count solid voxels of 4 source rows with Simd::BlockCounts,
+			empty blocks are skipped without voting. Threads own output
+			slices, palette and materials stay.
+		*/
+		void Downsample(float threshold = 0.5f) {
+			VOX		half(layout);
+			half.Resize(vec<int>((size.x + 1) / 2, (size.y + 1) / 2, (size.z + 1) / 2));
+			std::copy(palette, palette + 256, half.palette);
+			std::copy(materials, materials + 256, half.materials);
+			half.version	= version;
+			vec<int>	dim		= half.size;
+
+#ifdef __unix__
+			#pragma omp parallel for schedule(dynamic)
+#endif
+			for(int z = 0; z < dim.z; ++z) {
+				std::vector<uchar>	counts(dim.x);
+				std::vector<uchar>	zeros(layout == LINEAR? size.x: 0);	//Rows past grid end
+				for(int y = 0; y < dim.y; ++y) {
+					int		ys		= std::min(2, size.y - 2 * y);
+					int		zs		= std::min(2, size.z - 2 * z);
+
+					//Solid voxels per block
+					std::fill(counts.begin(), counts.end(), 0);
+					int		x		= 0;
+					if(layout == LINEAR) {
+						const uchar*	rows[4];
+						for(int r = 0; r < 4; ++r) {
+							int	dy	= r & 1;
+							int	dz	= r >> 1;
+							rows[r]	= dy < ys and dz < zs? LinearRow(2 * y + dy, 2 * z + dz): zeros.data();
+						}
+						x	= size.x / 2;
+						Simd::BlockCounts(rows, x, counts.data());
+					}
+					for(; x < dim.x; ++x)
+						for(int dz = 0; dz < zs; ++dz)
+							for(int dy = 0; dy < ys; ++dy)
+								for(int dx = 0; dx < 2 and 2 * x + dx < size.x; ++dx)
+									counts[x] += GetVoxelRaw(2 * x + dx, 2 * y + dy, 2 * z + dz) not_eq 0;
+
+					//Majority color of blocks solid enough
+					for(x = 0; x < dim.x; ++x) {
+						int		inside	= std::min(2, size.x - 2 * x) * ys * zs;
+						uchar	ID		= 0;
+						if(counts[x] > 0 and counts[x] >= threshold * inside) {
+							uchar	colors[8];
+							int		solid	= 0;
+							for(int dz = 0; dz < zs; ++dz)
+								for(int dy = 0; dy < ys; ++dy)
+									for(int dx = 0; dx < 2 and 2 * x + dx < size.x; ++dx)
+										if(uchar c = GetVoxelRaw(2 * x + dx, 2 * y + dy, 2 * z + dz))
+											colors[solid++]	= c;
+							int		best	= 0;
+							for(int i = 0; i < solid; ++i) {
+								int	votes	= 0;
+								for(int j = 0; j < solid; ++j)
+									votes	+= colors[j] == colors[i];
+								if(votes > best or (votes == best and colors[i] < ID)) {
+									best	= votes;
+									ID		= colors[i];
+								}
+							}
+						}
+						half.SetVoxelRaw(x, y, z, ID);
 					}
 				}
 			}
+			Swap(half);
+		}
+
+		//Exchanges whole content (grid, palette, materials, layout)
+		void Swap(VOX& other) {
+			std::swap(size, other.size);
+			std::swap(palette, other.palette);
+			std::swap(materials, other.materials);
+			std::swap(voxel, other.voxel);
+			std::swap(capacity, other.capacity);
+			std::swap(storage, other.storage);
+			std::swap(layout, other.layout);
+			for(int i = 0; i < 3; ++i)
+				offsets[i].swap(other.offsets[i]);
+			std::swap(version, other.version);
 		}
 
 	private:
-		void Alloc(int x, int y, int z) {
+		void Alloc(int x, int y, int z, bool clear = true) {
 			size.Set(x, y, z);
-			unsigned int wholeSize	= x * y * z;
-			if(voxel not_eq nullptr)
-				delete[]	voxel;
-			voxel					= new uchar[wholeSize];
-			memset(voxel, 0, wholeSize);
+			BuildOffsets();
+			size_t wholeSize	= storage;
+			if(wholeSize > capacity or voxel == nullptr) {
+				if(voxel not_eq nullptr)
+					ScratchMemory::Free(voxel);
+				voxel		= ScratchMemory::Allocate(wholeSize > 0? wholeSize: 1);
+				capacity	= voxel not_eq nullptr? wholeSize: 0;
+				//Same failure as new[] had, grid must not be touched
+				if(voxel == nullptr)
+					throw std::bad_alloc();
+			}
+			if(clear) {
+				//Touching pages from all threads also spreads first touch faults
+				long long	slices	= z > 0? z: 1;
+				size_t		slice	= wholeSize / slices;
+#ifdef __unix__
+				#pragma omp parallel for
+#endif
+				for(long long i = 0; i < slices; ++i)
+					memset(voxel + i * slice, 0, i == slices - 1? wholeSize - i * slice: slice);
+			}
+		}
+
+		//Occluded fills: seeds spread towards higher (Up) / lower (Down) bits through set bits of open
+		static inline uint64_t FillUp(uint64_t seeds, uint64_t open) {
+			for(int shift = 1; shift < 64; shift *= 2) {
+				seeds	|= open & (seeds << shift);
+				open	&= open << shift;
+			}
+			return seeds;
+		}
+		static inline uint64_t FillDown(uint64_t seeds, uint64_t open) {
+			for(int shift = 1; shift < 64; shift *= 2) {
+				seeds	|= open & (seeds >> shift);
+				open	&= open >> shift;
+			}
+			return seeds;
+		}
+
+		/*
+			Index = offsets[0][x] + offsets[1][y] + offsets[2][z], each axis
+			splits coordinate into brick (outer) and in-brick (inner) part.
+			LINEAR is TILED with 1x1x1 bricks.
+		*/
+		void BuildOffsets() {
+			int		shift	= layout;
+			int		mask	= (1 << shift) - 1;
+			size_t	volume	= size_t(1) << (3 * shift);
+			size_t	stride	= volume;
+			for(int axis = 0; axis < 3; ++axis) {
+				int		count	= size.raw[axis] > 0? size.raw[axis]: 0;
+				size_t	bricks	= (count + mask) >> shift;
+				offsets[axis].resize(count + 2);
+				for(int i = 0; i < count; ++i) {
+					offsets[axis][i + 1]	= (i >> shift) * stride
+											+ (size_t(i & mask) << (shift * axis));
+				}
+				stride	*= bricks;
+			}
+			storage	= stride;
+			for(int axis = 0; axis < 3; ++axis)
+				offsets[axis].front()	= offsets[axis].back()	= storage;
 		}
 
 		class Chunk {
@@ -383,7 +999,7 @@ class VOX {
 				}
 		};
 
-		bool ReadFile(ifstream& hFile) {
+		bool ReadFile(ifstream& hFile, const AxisTransform& transform) {
 			//Magic number
 			int magic;
 			hFile.read(reinterpret_cast<char*>(&magic), 4);
@@ -412,7 +1028,17 @@ class VOX {
 				hFile.seekg(static_cast<int>(hFile.tellg()) + mainChunk.contentSize);
 			
 			bool	customPalette	= false;
+			std::fill(materials, materials + 256, Material());
 			int		numVoxels		= 0;
+			vec<int>	fileSize;
+
+			//Per source axis: destination axis and whether it is mirrored
+			int		target[3];
+			bool	mirror[3];
+			for(int i = 0; i < 3; ++i) {
+				target[transform.axis[i]]	= i;
+				mirror[transform.axis[i]]	= transform.mirror[i];
+			}
 
 			//Read children chunks
 			while(hFile.tellg() < mainChunk.end) {
@@ -426,9 +1052,10 @@ class VOX {
 				
 				switch(childrenChunk.id) {
 					case(Chunk::Type::SIZE): {
-						hFile.read(reinterpret_cast<char*>(&size), 12);
+						hFile.read(reinterpret_cast<char*>(&fileSize), 12);
 
-						Alloc(size.x, size.y, size.z);
+						vec<int>	newSize	= transform.Size(fileSize);
+						Alloc(newSize.x, newSize.y, newSize.z);
 						break;
 					}
 					case(Chunk::Type::XYZI): {
@@ -438,10 +1065,12 @@ class VOX {
 								vec<uchar>	readVoxel;
 								hFile.read(reinterpret_cast<char*>(&readVoxel), 4);
 
-								int idx		= readVoxel.x + size.x * (
-									readVoxel.y + size.y * readVoxel.z
-								);
-								voxel[idx] 	= readVoxel.w;
+								vec<int>	pos;
+								for(int a = 0; a < 3; ++a) {
+									int	c	= readVoxel.raw[a];
+									pos.raw[target[a]]	= mirror[a]? fileSize.raw[a] - c - 1: c;
+								}
+								SetVoxel(pos.x, pos.y, pos.z, readVoxel.w);
 							}
 						} else {
 							cerr	<< "[VOX] Improper voxel number, file broken!" << endl;
@@ -463,8 +1092,47 @@ class VOX {
 						//cout	<< "[VOX] Multiple models are not supported, ignoring rest of model!" << endl;
 						break;
 					}
-					case(Chunk::Type::MATT):
-					case(Chunk::Type::MATL):
+					case(Chunk::Type::MATL): {
+						//Material ID is voxel color index (1 - 255)
+						int							id	= 0;
+						std::map<string, string>	properties;
+						hFile.read(reinterpret_cast<char*>(&id), 4);
+						if(ReadDictionary(hFile, childrenChunk.end, properties) and id >= 1 and id <= 255)
+							materials[id - 1]	= ParseMaterial(properties);
+						break;
+					}
+					case(Chunk::Type::MATT): {
+						//Legacy: ID, type, weight, property bits and float per bit (last one has no value)
+						int		header[2]	= {0, 0};
+						float	weight		= 0.0f;
+						int		bits		= 0;
+						float	values[7]	= {};
+						hFile.read(reinterpret_cast<char*>(header), 8);
+						hFile.read(reinterpret_cast<char*>(&weight), 4);
+						hFile.read(reinterpret_cast<char*>(&bits), 4);
+						for(int i = 0; i < 7; ++i)
+							if(bits & (1 << i))
+								hFile.read(reinterpret_cast<char*>(&values[i]), 4);
+
+						int	id	= header[0];
+						if(not hFile.fail() and id >= 1 and id <= 255) {
+							Material&	material	= materials[id - 1];
+							material	= Material();
+							switch(header[1]) {
+								case 1:	material.type	= Material::METAL;	material.metal	= weight;	break;
+								case 2:	material.type	= Material::GLASS;	material.trans	= weight;	break;
+								case 3:	material.type	= Material::EMIT;	material.emit	= weight;	break;
+							}
+							if(material.type not_eq Material::DIFFUSE) {
+								if(bits & 2)
+									material.rough	= values[1];
+								if(bits & 8)
+									material.ior	= values[3] < 1.0f? 1.0f + values[3]: values[3];
+							}
+						}
+						hFile.clear();
+						break;
+					}
 					case(Chunk::Type::DICT):
 					case(Chunk::Type::nTRN):
 					case(Chunk::Type::nGRP):
@@ -491,14 +1159,76 @@ class VOX {
 			return true;
 		}
 
+		//DICT: count, then key and value strings (int size, chars), false when it crosses end
+		static bool ReadDictionary(ifstream& hFile, long int end, std::map<string, string>& dictionary) {
+			int	count	= 0;
+			hFile.read(reinterpret_cast<char*>(&count), 4);
+			for(int i = 0; i < count; ++i) {
+				string	pair[2];
+				for(string& text : pair) {
+					int	length	= 0;
+					hFile.read(reinterpret_cast<char*>(&length), 4);
+					if(hFile.fail() or length < 0 or static_cast<long int>(hFile.tellg()) + length > end) {
+						hFile.clear();
+						return false;
+					}
+					text.resize(length);
+					hFile.read(&text[0], length);
+				}
+				dictionary[pair[0]]	= pair[1];
+			}
+			return not hFile.fail();
+		}
+
+		/*
+			MATL properties ("_type", "_metal", ...) as text, type specific
+			strength falls back to "_weight" (older files). IOR is stored
+			without 1.0 (0.3 => 1.3).
+		*/
+		static Material ParseMaterial(const std::map<string, string>& properties) {
+			auto	value	= [&](const char* key, float fallback) -> float {
+				auto	it	= properties.find(key);
+				return it == properties.end()? fallback: float(atof(it->second.c_str()));
+			};
+			auto	type	= properties.find("_type");
+			string	name	= type == properties.end()? "_diffuse": type->second;
+			float	weight	= value("_weight", 1.0f);
+
+			Material	material;
+			if(name == "_metal") {
+				material.type	= Material::METAL;
+				material.metal	= value("_metal", weight);
+			} else if(name == "_glass") {
+				material.type	= Material::GLASS;
+				material.trans	= value("_trans", value("_alpha", weight));
+			} else if(name == "_emit") {
+				material.type	= Material::EMIT;
+				material.emit	= value("_emit", weight);
+			} else if(name == "_blend") {
+				material.type	= Material::BLEND;
+				material.metal	= value("_metal", 0.0f);
+				material.trans	= value("_trans", value("_alpha", 0.0f));
+				material.emit	= value("_emit", 0.0f);
+			} else if(name == "_media") {
+				material.type	= Material::MEDIA;
+				material.trans	= value("_trans", weight);
+			} else
+				return material;
+
+			material.rough	= value("_rough", material.rough);
+			float	ior		= value("_ior", material.ior - 1.0f);
+			material.ior	= ior < 1.0f? 1.0f + ior: ior;
+			return material;
+		}
+
 		bool WriteFile(ofstream& hFile) {
 			//Temporary
 			int	chunkSize	= 0;
 			int numVoxels	= 0;
 
 			//Calculation of existing voxels
-			int wholeSize	= size.x * size.y * size.z;
-			for(int i = 0; i < wholeSize; ++i)
+			//Brick padding is always empty
+			for(size_t i = 0; i < storage; ++i)
 				if(voxel[i] > 0)
 					++numVoxels;
 
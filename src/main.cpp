@@ -1,6 +1,6 @@
 #if 0
 #!/bin/bash
-g++ $0 -Wall -fpermissive -pthread -msse2 -msse4.1 -fopenmp\
+g++ $0 -Wall -fpermissive -pthread -msse2 -fopenmp\
 	-Wno-unused-result --std=c++17 -O2 -o ./../bin/vox2mc
 exit
 #endif
@@ -10,6 +10,14 @@ exit
 #include <chrono>
 #include <algorithm>
 #include <fstream>
+#include <memory>
+#include <thread>
+#include <sstream>
+#include <iomanip>
+
+#ifdef __unix__
+	#include <omp.h>
+#endif
 
 using std::string;
 using std::cerr;
@@ -26,8 +34,39 @@ using std::chrono::time_point;
 
 #include "VOX.h"
 #include "MC.h"
+#include "Pipeline.h"
+#include "Collision.h"
+
+//Reusable scratch memory shared by all conversions of a run
+struct ConversionContext {
+	ObjectPool<VOX>					sources;	//Loaded input models
+	ObjectPool<VOX>					grids;		//Upscaled MC grids
+	ObjectPool<MarchingCubeModel>	meshes;		//Output mesh buffers
+};
+
+//Single file state passed between batch pipeline stages
+struct BatchJob {
+	size_t								idx	= 0;
+	string								inPath;
+	string								outPath;
+	string								progress;
+	string								error;
+
+	std::unique_ptr<VOX>				model;
+	std::unique_ptr<MarchingCubeModel>	output;
+	MarchingCubeModel::MeshStats		stats;		//Dry run only
+	MarchingCubeModel::CacheStats		cache;		//Vertex cache optimization only
+
+	time_point<high_resolution_clock>	start;
 
-void CreateMTL(string texturePath, string mtlPath);
+	size_t								bytes	= 0;		//Input size, shard manifest
+	bool								good	= false;	//Converted and written
+	size_t								peak	= 0;		//Estimated memory, -ml only
+	bool								streamed	= false;	//Over memory limit, meshed straight to file
+	vector<size_t>						copies;		//Other files of same model, -dd only
+};
+
+void CreateMTL(string texturePath, string mtlPath, string mtlName = "material.mtl", string materials = "");
 
 int main(int argc, char** argv) {
 	//Checking args
@@ -53,11 +92,60 @@ int main(int argc, char** argv) {
 	paramManager.addParamSeparator();
 
 	paramManager.addParam("-mtl", "--material", "Creates simple MTL file (included in OBJ) with given texture", "TEXTURE_PATH");	
+	paramManager.addParam(
+		"-pal", "--palette", "Generates 256x1 palette PNG and MTL per model (MODEL.png, MODEL.mtl)", ""
+	);
+	paramManager.addParam(
+		"-vc", "--vertex-colors", "Writes per vertex colors into OBJ ('v x y z r g b')", ""
+	);
+	paramManager.addParam(
+		"-f", "--format", "Sets output format: obj, ply or glb (vertex colored), default: from -o extension or obj",
+		"FORMAT"
+	);
+	paramManager.addParam(
+		"-n", "--normals", "Sets normals: 'none', 'flat' or 'smooth', default: flat (OBJ), smooth (-q GLB), none", "MODE"
+	);
+	paramManager.addParam(
+		"-ca", "--crease", "Keeps 'smooth' normals sharp over edges above ANGLE degrees, default: 180", "ANGLE"
+	);
+	paramManager.addParam(
+		"-q", "--quantize", "Writes GLB with 16 bit positions and 8 bit normals (KHR_mesh_quantization)", ""
+	);
+	paramManager.addParam(
+		"-c", "--compress", "Writes GLB buffers meshopt compressed (EXT_meshopt_compression), implies -q", ""
+	);
 
 	paramManager.addParamSeparator();
 
 	paramManager.addParam("-s", "--scale", "Changes scale of output OBJ, default: 0.03125", "SCALE");
 	paramManager.addParam("-u", "--upscale", "Changes upscaling factor of conversion, default: 3.0", "FACTOR");
+	paramManager.addParam(
+		"-m", "--mesher", "Sets surface extraction: 'mc' (upscaled marching cubes) or 'sn' (surface nets), default: mc",
+		"MESHER"
+	);
+	paramManager.addParam("-b", "--bevel", "Changes edge rounding of 'sn' mesher (0.0 - 1.0), default: 1.0", "BEVEL");
+
+	paramManager.addParam(
+		"-ti", "--tile", "Splits model into TILE^3 voxel tiles, one mesh per tile plus index file (mc only)", "TILE"
+	);
+
+	paramManager.addParam(
+		"-lv", "--level",
+		"Meshes mip level of model, every level halves grid (2x2x2 blocks, majority color), default: 0", "LEVEL"
+	);
+	paramManager.addParam(
+		"-lt", "--level-threshold", "Part of 2x2x2 block that has to be solid to stay solid, default: 0.5", "RATIO"
+	);
+	paramManager.addParam(
+		"-fc", "--fill-cavities", "Fills sealed interior cavities, so their never visible surfaces are not meshed", ""
+	);
+	paramManager.addParam(
+		"-cb", "--collision",
+		"Also writes collider as merged voxel boxes to <name>.collision.<FORMAT>: 'json', 'bin' or 'obj'", "FORMAT"
+	);
+	paramManager.addParam(
+		"-st", "--stream", "Writes OBJ while meshing, mesh memory stays bounded (mc only, flat or no normals)", ""
+	);
 
 	paramManager.addParam("-fx", "--flip-x", "Flips model by mirroring X axis", "");
 	paramManager.addParam("-fy", "--flip-y", "Flips model by mirroring Y axis", "");
@@ -70,6 +158,45 @@ int main(int argc, char** argv) {
 	paramManager.addParamSeparator();
 
 	paramManager.addParam("-t", "--time", "Shows time of VOX to OBJ conversion", "");
+	paramManager.addParam(
+		"-oc", "--optimize-cache", "Reorders triangles/vertices for GPU vertex cache and fetch, reports ACMR", ""
+	);
+	paramManager.addParam(
+		"-dr", "--dry-run", "Only reports exact output mesh sizes, nothing is meshed nor written", ""
+	);
+	paramManager.addParam(
+		"-ix", "--inspect",
+		"Writes index of -i file or -id tree (size, voxels, models, palette hash, peak memory for -u) "
+		"as CSV or JSON (by extension) from VOX headers only, nothing is converted", "INDEX"
+	);
+	paramManager.addParam(
+		"-hp", "--huge-pages", "Backs big scratch grids with transparent huge pages (Linux only)", ""
+	);
+	paramManager.addParam(
+		"-l", "--layout", "Sets memory order of voxel grids: 'linear' or 'tiled' (4x4x4 bricks), default: linear",
+		"LAYOUT"
+	);
+	paramManager.addParam(
+		"-j", "--jobs", "Sets number of concurrent conversions in batch mode, default: CPU count", "WORKERS"
+	);
+	paramManager.addParam(
+		"-dd", "--dedup",
+		"Converts identical models (voxels, palette, materials) of batch once and links or copies outputs", ""
+	);
+	paramManager.addParam(
+		"-ml", "--mem-limit",
+		"Limits estimated memory of concurrent batch conversions, bigger ones are streamed (OBJ) or run alone",
+		"MB"
+	);
+	paramManager.addParam(
+		"-sh", "--shard",
+		"Converts only shard K (0 - N-1) of N of -id tree (by hash of relative path), writes shard.K-of-N.csv manifest",
+		"K/N"
+	);
+	paramManager.addParam(
+		"-sd", "--simd",
+		"Forces vector kernels: 'scalar', 'sse4.1', 'avx2' or 'avx512', default: best one of CPU", "LEVEL"
+	);
 
 	if(paramManager.process(argc, argv) == false)
 		return 1;
@@ -79,6 +206,15 @@ int main(int argc, char** argv) {
 	float	scale	= paramManager.getValueOfFloat("-s", 0.03125f);
 	float	upscale	= paramManager.getValueOfFloat("-u", 3.0f);
 
+	//Mip level, voxel of level is 2^level source voxels so model keeps its size
+	int		level		= int(paramManager.getValueOfFloat("-lv", 0.0f));
+	float	threshold	= paramManager.getValueOfFloat("-lt", 0.5f);
+	if(level < 0 or level > 16 or threshold <= 0.0f or threshold > 1.0f) {
+		cerr	<< "Level has to be 0 - 16 and its threshold 0 - 1! Aborting..." << endl;
+		return 1;
+	}
+	scale	*= float(1 << level);
+
 	bool	flipX	= paramManager.hasValue("-fx")?
 		paramManager.getValueOf("-fx") == "1": false;
 	bool	flipY	= paramManager.hasValue("-fy")?
@@ -86,19 +222,368 @@ int main(int argc, char** argv) {
 	bool	flipZ	= paramManager.hasValue("-fz")?
 		paramManager.getValueOf("-fz") == "1": false;
 
+	//Optional flips, applied while decoding voxels
+	AxisTransform	flips	= AxisTransform::Flip(flipX, flipY, flipZ);
+
+	string	mesher	= paramManager.hasValue("-m")? paramManager.getValueOf("-m"): "mc";
+	float	bevel	= paramManager.getValueOfFloat("-b", 1.0f);
+	if(mesher not_eq "mc" and mesher not_eq "sn") {
+		cerr	<< "Unknown mesher \"" << mesher << "\"! Aborting..." << endl;
+		return 1;
+	}
+
+	int		tile	= paramManager.hasValue("-ti")? int(paramManager.getValueOfFloat("-ti")): 0;
+	if(tile < 0 or (tile > 0 and (mesher not_eq "mc" or upscale not_eq floor(upscale)))) {
+		cerr	<< "Tiles need positive size, 'mc' mesher and integer upscale! Aborting..." << endl;
+		return 1;
+	}
+
+	bool	palette			= paramManager.hasValue("-pal");
+	bool	vertexColors	= paramManager.hasValue("-vc");
+	bool	compress		= paramManager.hasValue("-c");
+	float	crease			= paramManager.getValueOfFloat("-ca", 180.0f);
+	string	normalName		= Helper::ToLower(paramManager.getValueOf("-n"));
+	auto	normalMode		=
+			normalName == "none"?	MarchingCubeModel::NO_NORMALS:
+			normalName == "flat"?	MarchingCubeModel::FLAT_NORMALS:
+			normalName == "smooth"?	MarchingCubeModel::SMOOTH_NORMALS:
+									MarchingCubeModel::AUTO_NORMALS;
+	if(normalName not_eq "" and normalMode == MarchingCubeModel::AUTO_NORMALS) {
+		cerr	<< "Unknown normals \"" << normalName << "\"! Aborting..." << endl;
+		return 1;
+	}
+	bool	quantize		= compress or paramManager.hasValue("-q");
+	string	format			= Helper::ToLower(paramManager.getValueOf("-f"));
+	if(format not_eq "" and format not_eq "obj" and format not_eq "ply" and format not_eq "glb") {
+		cerr	<< "Unknown format \"" << format << "\"! Aborting..." << endl;
+		return 1;
+	}
+
 	vec<float>	offset(
 		paramManager.getValueOfFloat("-ox", 0),
 		paramManager.getValueOfFloat("-oy", 0),
 		paramManager.getValueOfFloat("-oz", 0)
 	);
 
+	size_t	workers	= paramManager.hasValue("-j")?
+		size_t(std::max(1.0f, paramManager.getValueOfFloat("-j"))):
+		size_t(std::max(1u, std::thread::hardware_concurrency()));
+
+	//Shard of batch, every node computes same split from same tree
+	int		shardIndex	= 0;
+	int		shardCount	= 1;
+	bool	sharded		= paramManager.hasValue("-sh");
+	if(sharded and (
+		sscanf(paramManager.getValueOf("-sh").c_str(), "%d/%d", &shardIndex, &shardCount) not_eq 2
+	or	shardCount < 1 or shardIndex < 0 or shardIndex >= shardCount
+	)) {
+		cerr	<< "Shard has to be K/N with 0 <= K < N! Aborting..." << endl;
+		return 1;
+	}
+
+	size_t	memLimit	= size_t(paramManager.getValueOfFloat("-ml", 0.0f) * 1048576.0);
+	if(paramManager.hasValue("-ml") and memLimit == 0) {
+		cerr	<< "Memory limit has to be positive! Aborting..." << endl;
+		return 1;
+	}
+
+	bool	dryRun		= paramManager.hasValue("-dr");
+	bool	optimize	= paramManager.hasValue("-oc");
+	bool	cavities	= paramManager.hasValue("-fc");
+	bool	stream		= paramManager.hasValue("-st");
+	bool	dedup		= paramManager.hasValue("-dd");
+	string	outName		= Helper::ToLower(paramManager.getValueOf("-o"));
+	string	outFormat	= format not_eq ""? format: outName.substr(outName.find_last_of('.') + 1);
+	if(stream and (
+		mesher not_eq "mc" or tile > 0 or vertexColors or optimize
+	or	normalMode == MarchingCubeModel::SMOOTH_NORMALS or outFormat == "ply" or outFormat == "glb"
+	)) {
+		cerr	<< "Streaming needs OBJ output, 'mc' mesher, no tiles, -vc, -oc nor smooth normals! Aborting..." << endl;
+		return 1;
+	}
+	if(dedup and tile > 0) {
+		cerr	<< "Deduplication does not work with tiles! Aborting..." << endl;
+		return 1;
+	}
+
+	string	collision	= Helper::ToLower(paramManager.getValueOf("-cb"));
+	if(collision not_eq "" and collision not_eq "json" and collision not_eq "bin" and collision not_eq "obj") {
+		cerr	<< "Unknown collision format \"" << collision << "\"! Aborting..." << endl;
+		return 1;
+	}
+
+	string		layoutName	= Helper::ToLower(paramManager.getValueOf("-l"));
+	VOX::Layout	layout		= layoutName == "tiled"? VOX::TILED: VOX::LINEAR;
+	if(layoutName not_eq "" and layoutName not_eq "linear" and layoutName not_eq "tiled") {
+		cerr	<< "Unknown layout \"" << layoutName << "\"! Aborting..." << endl;
+		return 1;
+	}
+
+	//Vector kernels, output is same on every level
+	string		simdName	= Helper::ToLower(paramManager.getValueOf("-sd"));
+	Simd::Level	simdLevel	= Simd::Detect();
+	if(simdName not_eq "" and not Simd::Parse(simdName, simdLevel)) {
+		cerr	<< "Unknown SIMD level \"" << simdName << "\"! Aborting..." << endl;
+		return 1;
+	}
+	if(not Simd::Select(simdLevel)) {
+		cerr	<< "CPU does not support " << Simd::Name(simdLevel) << " (best: " << Simd::Name(Simd::Detect())
+				<< ")! Aborting..." << endl;
+		return 1;
+	}
+
+	ScratchMemory::hugePages	= paramManager.hasValue("-hp");
+	ConversionContext	context;
+
+	auto	setupModel	= [&](MarchingCubeModel& output) {
+		output.gridPool		= &context.grids;
+		output.gridLayout	= layout;
+		output.offset.Set(offset);
+		output.perVertexColors	= vertexColors;
+		output.quantize			= quantize;
+		output.compress			= compress;
+		output.normalMode		= normalMode;
+		output.creaseAngle		= crease;
+		output.materialEntries	= false;	//Set where MTL with its entries is written
+	};
+
+	auto	meshModel	= [&](VOX& model, MarchingCubeModel& output) -> MarchingCubeModel::CacheStats {
+		setupModel(output);
+		if(mesher == "sn")
+			output.LoadVoxelsSurfaceNets(model, scale, upscale, bevel);
+		else
+			output.LoadVoxels(model, scale, upscale);
+		return optimize? output.OptimizeVertexOrder(): MarchingCubeModel::CacheStats();
+	};
+
+	auto	measureModel	= [&](VOX& model, MarchingCubeModel& output) -> MarchingCubeModel::MeshStats {
+		output.gridPool		= &context.grids;
+		output.gridLayout	= layout;
+		if(mesher == "sn")
+			return MarchingCubeModel::MeasureSurfaceNets(model);
+		return output.Measure(model, upscale);
+	};
+
+	//Peak guess at mip level, whole source grid is still loaded first
+	auto	estimatePeak	= [&](const VOX::Header& header, size_t slabTriangles = 0) -> size_t {
+		vec<int>	reduced	= header.size;
+		for(int l = 0; l < level; ++l)
+			reduced	= vec<int>((reduced.x + 1) / 2, (reduced.y + 1) / 2, (reduced.z + 1) / 2);
+		size_t		source	= size_t(header.size.x) * header.size.y * header.size.z;
+		return	MarchingCubeModel::EstimatePeakBytes(reduced, header.voxels, upscale, slabTriangles)
+			+	(level > 0? source: 0);
+	};
+
+	//Merged boxes of source voxels next to output (<name>.collision.<format>)
+	auto	collisionPath	= [&](const string& outPath) -> string {
+		return outPath.substr(0, outPath.find_last_of('.')) + ".collision." + collision;
+	};
+	auto	saveCollision	= [&](VOX& model, const string& outPath) -> bool {
+		CollisionBoxes	collider;
+		collider.Build(model, AxisTransform(), scale, upscale, offset);
+		return collider.Save(collisionPath(outPath));
+	};
+
+	auto	printStats	= [](const MarchingCubeModel::MeshStats& stats) {
+		cout	<< " v: " << stats.vertices << ", t: " << stats.triangles
+				<< ", " << (stats.Bytes() / 1048576.0) << "MB";
+	};
+
+	auto	printCache	= [](const MarchingCubeModel::CacheStats& cache) {
+		cout	<< " ACMR: " << cache.before << " => " << cache.after;
+	};
+
+	//Names model after output file and writes it with optional palette texture, streamed one is meshed too
+	auto	saveModel	= [&](MarchingCubeModel& output, const string& outPath, VOX* streamed = nullptr) -> bool {
+		size_t	idx		= outPath.find_last_of('/');
+		size_t	idxEnd	= outPath.find_last_of('.');
+		output.name		= outPath.substr(idx + 1, idxEnd - idx - 1);
+		if(streamed) {
+			setupModel(output);
+			output.materialLib		= palette? output.name + ".mtl": "material.mtl";
+			output.materialEntries	= palette;
+			if(not output.StreamOBJ(*streamed, outPath, scale, upscale))
+				return false;
+		}
+
+		if(palette) {
+			string	dir	= Helper::GetParentPath(outPath) + "/";
+			if(not output.SavePalette(dir + output.name + ".png"))
+				return false;
+			output.materialLib		= output.name + ".mtl";
+			output.materialEntries	= true;
+			CreateMTL(
+				output.name + ".png", outPath, output.materialLib, output.MaterialLibrary(output.name + ".png")
+			);
+		}
+		return streamed or output.Save(outPath);
+	};
+
+	/*
+		Meshes model tile by tile (tiles in parallel) and writes every
+		non empty tile as <name>_X_Y_Z.<ext> plus <name>.tiles.json with
+		tile voxel ranges (Unity oriented: X, Z, Y of VOX) and mesh bounds.
+	*/
+	auto	saveTiles	= [&](VOX& model, const string& outPath) -> bool {
+		size_t	dot		= outPath.find_last_of('.');
+		string	base	= outPath.substr(0, dot);
+		string	ext		= outPath.substr(dot);
+		coord	grid	= MarchingCubeModel::TileGrid(model);
+		coord	count(
+			(grid.x + tile - 1) / tile, (grid.y + tile - 1) / tile, (grid.z + tile - 1) / tile
+		);
+		int				tiles	= count.x * count.y * count.z;
+		vector<string>	entries(tiles);
+		bool			good	= true;
+
+#ifdef __unix__
+		#pragma omp parallel for schedule(dynamic)
+#endif
+		for(int t = 0; t < tiles; ++t) {
+			coord	id(t % count.x, (t / count.x) % count.y, t / (count.x * count.y));
+			coord	min(id.x * tile, id.y * tile, id.z * tile);
+			coord	max(
+				std::min(grid.x, min.x + tile), std::min(grid.y, min.y + tile), std::min(grid.z, min.z + tile)
+			);
+
+			std::unique_ptr<MarchingCubeModel>	output	= context.meshes.Acquire();
+			setupModel(*output);
+			output->LoadVoxelsTile(model, min, max, scale, upscale);
+			if(optimize)
+				output->OptimizeVertexOrder();
+
+			vertex	low;
+			vertex	high;
+			if(output->Bounds(low, high)) {
+				string	path	= base + "_" + std::to_string(id.x) + "_" + std::to_string(id.y)
+								+ "_" + std::to_string(id.z) + ext;
+				if(not saveModel(*output, path)) {
+#ifdef __unix__
+					#pragma omp critical
+#endif
+					good	= false;
+				}
+
+				std::ostringstream	entry;
+				entry	<< std::setprecision(9)
+						<< "\t\t{\"file\": \"" << Helper::EscapeJSON(path.substr(path.find_last_of('/') + 1)) << "\", "
+						<< "\"voxels\": {\"min\": [" << min.x << ", " << min.y << ", " << min.z << "], "
+						<< "\"max\": [" << max.x << ", " << max.y << ", " << max.z << "]}, "
+						<< "\"bounds\": {\"min\": [" << low.x << ", " << low.y << ", " << low.z << "], "
+						<< "\"max\": [" << high.x << ", " << high.y << ", " << high.z << "]}, "
+						<< "\"vertices\": " << output->Stats().vertices << ", "
+						<< "\"triangles\": " << output->Stats().triangles << "}";
+				entries[t]	= entry.str();
+			}
+			context.meshes.Release(std::move(output));
+		}
+
+		ofstream	hIndex(base + ".tiles.json", std::ios::trunc bitor std::ios::out);
+		hIndex	<< "{\n"
+				<< "\t\"tile\": " << tile << ",\n"
+				<< "\t\"upscale\": " << upscale << ",\n"
+				<< "\t\"scale\": " << scale << ",\n"
+				<< "\t\"voxels\": [" << grid.x << ", " << grid.y << ", " << grid.z << "],\n"
+				<< "\t\"tiles\": [";
+		bool	first	= true;
+		for(string& entry : entries) {
+			if(entry.empty())
+				continue;
+			hIndex	<< (first? "\n": ",\n") << entry;
+			first	= false;
+		}
+		hIndex	<< "\n\t]\n}\n";
+		hIndex.close();
+		return good and not hIndex.fail();
+	};
+
 	//Time
 	bool								timeShow	= paramManager.hasValue("-t");
-	time_point<high_resolution_clock>	start		= high_resolution_clock::now();
 	time_point<high_resolution_clock>	overallTime	= high_resolution_clock::now();
 
+	//Header only index, files are inspected in parallel
+	if(paramManager.hasValue("-ix")) {
+		string			root;
+		vector<string>	files;
+		if(paramManager.hasValue("-id")) {
+			root	= Helper::GetAbsolutePath(paramManager.getValueOf("-id"));
+			if(not Helper::IsDir(root)) {
+				cerr << "[Directory] Input directory is inaccesible, does not exists or is not a directory!" << endl;
+				return 1;
+			}
+			vector<string>	dirs(1, root);
+			Helper::GetDirectoriesList(dirs);
+			files	= Helper::FindFilesWithExtension(dirs, "vox");
+		} else {
+			string	in	= Helper::GetAbsolutePath(paramManager.getValueOf("-i"));
+			root	= Helper::GetParentPath(in);
+			files.push_back(in);
+		}
+
+		int					count	= files.size();
+		vector<VOX::Header>	headers(count);
+		vector<char>		valid(count, 0);
+#ifdef __unix__
+		#pragma omp parallel for schedule(dynamic, 16)
+#endif
+		for(int i = 0; i < count; ++i) {
+			VOX	reader;
+			valid[i]	= reader.Inspect(files[i], headers[i]);
+		}
+
+		string		indexPath	= paramManager.getValueOf("-ix");
+		bool		json		= Helper::EndsWith(Helper::ToLower(indexPath), ".json");
+		ofstream	hIndex(indexPath, std::ios::trunc bitor std::ios::out);
+		if(json)
+			hIndex	<< "{\n\t\"upscale\": " << upscale << ",\n\t\"files\": [";
+		else
+			hIndex	<< "path,size_x,size_y,size_z,voxels,models,palette_hash,peak_bytes\n";
+
+		int		inspected	= 0;
+		size_t	voxels		= 0;
+		size_t	peak		= 0;
+		for(int i = 0; i < count; ++i) {
+			if(not valid[i]) {
+				cerr	<< "[Error] " << files[i] << " is not readable VOX file!" << endl;
+				continue;
+			}
+			const VOX::Header&	header	= headers[i];
+			string				path	= files[i].substr(std::min(files[i].size(), root.size() + 1));
+			size_t				bytes	= estimatePeak(header);
+			std::ostringstream	hash;
+			hash	<< std::hex << std::setw(16) << std::setfill('0') << header.paletteHash;
+			if(json) {
+				hIndex	<< (inspected > 0? ",\n": "\n")
+						<< "\t\t{\"path\": \"" << Helper::EscapeJSON(path) << "\", "
+						<< "\"size\": [" << header.size.x << ", " << header.size.y << ", " << header.size.z << "], "
+						<< "\"voxels\": " << header.voxels << ", \"models\": " << header.models << ", "
+						<< "\"palette_hash\": \"" << hash.str() << "\", \"peak_bytes\": " << bytes << "}";
+			} else {
+				hIndex	<< Helper::EscapeCSV(path) << ',' << header.size.x << ',' << header.size.y << ',' << header.size.z << ','
+						<< header.voxels << ',' << header.models << ',' << hash.str() << ',' << bytes << '\n';
+			}
+			++inspected;
+			voxels	+= header.voxels;
+			peak	= std::max(peak, bytes);
+		}
+		if(json)
+			hIndex	<< "\n\t]\n}\n";
+		hIndex.close();
+
+		cout	<< "[Inspect] " << inspected << " file(s), voxels: " << voxels
+				<< ", max peak: " << (peak / 1048576.0) << "MB";
+		if(timeShow)
+			cout	<< " (" << duration_cast<milliseconds>(high_resolution_clock::now() - overallTime).count() << "ms)";
+		cout	<< endl;
+		if(hIndex.fail()) {
+			cerr	<< "[Error] Cannot write index file!" << endl;
+			return 1;
+		}
+		return inspected == count? 0: 1;
+	}
+
 	//Convertion
-	bool multipleFiles = paramManager.hasValue("-id") and paramManager.hasValue("-od");
+	bool multipleFiles = paramManager.hasValue("-id") and (paramManager.hasValue("-od") or dryRun);
 	if(multipleFiles) {
 		string 		inDir	= Helper::GetAbsolutePath(paramManager.getValueOf("-id"));
 		if(Helper::IsDir(inDir)) {
@@ -116,71 +601,376 @@ int main(int argc, char** argv) {
 				outDirs.push_back(Helper::ReplaceAll(inDirs[i], inDir, outDir));
 			}
 
-			//Making directory tree copy
-			cout << "[Directories] Creating new directories tree..." << endl;
-			if(not Helper::CreateDirList(outDirs)) {
-				cerr	<< "[Error] Problem with output directory creation!" << endl;
-				return  1;
-			}
+			if(not dryRun) {
+				//Making directory tree copy
+				cout << "[Directories] Creating new directories tree..." << endl;
+				if(not Helper::CreateDirList(outDirs)) {
+					cerr	<< "[Error] Problem with output directory creation!" << endl;
+					return  1;
+				}
 
-			//MTL Creation
-			if(paramManager.hasValue("-mtl"))
-				CreateMTL(paramManager.getValueOf("-mtl"), outDir + "/");
+				//MTL Creation
+				if(paramManager.hasValue("-mtl"))
+					CreateMTL(paramManager.getValueOf("-mtl"), outDir + "/");
+			}
 
 			//Output files
 			cout << "[Files] Scanning files in directories tree..." << endl;
 			auto 	fileToConvert	= Helper::FindFilesWithExtension(inDirs, "vox");
-			int		idx				= 1;
-			for(string& entry : fileToConvert) {
-				if(timeShow)
-					start = high_resolution_clock::now();
-
-				//Load
-				cout << "[" << idx++ << "] " << entry << " [" << flush;
-				
-				VOX model;
-				if(not model.LoadFile(entry)) {
-					cerr	<< "[Error] Cannot open input file!" << endl;
-					return 1;
+			if(sharded)
+				std::sort(fileToConvert.begin(), fileToConvert.end());	//Same numbering on every node
+
+			vector<BatchJob>	jobs(fileToConvert.size());
+			for(size_t i = 0; i < fileToConvert.size(); ++i) {
+				jobs[i].idx		= i + 1;
+				jobs[i].inPath	= fileToConvert[i];
+				jobs[i].outPath	= Helper::ReplaceAll(fileToConvert[i], inDir, outDir);
+				jobs[i].bytes	= Helper::FileSize(fileToConvert[i]);
+
+				//Naive replace of VOX extension in filename
+				jobs[i].outPath.replace(
+					jobs[i].outPath.length() - 4, 4, "." + (format == ""? string("obj"): format)
+				);
+			}
+
+			/*
+				Shard split by rendezvous hashing: file goes to shard with
+				highest hash of (relative path, shard). Depends on that path
+				only, so other files of tree (missing, added, still syncing)
+				never move it and nodes need no coordination. Shards are
+				equal, every file lands anywhere with same chance, so shards
+				get about same bytes (and count) on larger trees.
+			*/
+			if(sharded) {
+				vector<char>	mine(jobs.size(), 0);
+				size_t			bytes	= 0;
+				for(size_t i = 0; i < jobs.size(); ++i) {
+					uint64_t	path	= Helper::StableHash(jobs[i].inPath.substr(inDir.size()));
+					int			best	= 0;
+					uint64_t	score	= 0;
+					for(int k = 0; k < shardCount; ++k) {
+						uint64_t	mixed	= Helper::MixHash(path ^ (uint64_t(k + 1) * 0x9E3779B97F4A7C15ull));
+						if(k == 0 or mixed > score) {
+							best	= k;
+							score	= mixed;
+						}
+					}
+					mine[i]	= best == shardIndex;
+					bytes	+= mine[i]? jobs[i].bytes: 0;
+				}
+
+				vector<BatchJob>	shard;
+				for(size_t i = 0; i < jobs.size(); ++i)
+					if(mine[i])
+						shard.push_back(std::move(jobs[i]));
+				jobs.swap(shard);
+				cout	<< "[Shard] " << shardIndex << '/' << shardCount << ": "
+						<< jobs.size() << " of " << fileToConvert.size() << " file(s), "
+						<< (bytes / 1048576.0) << "MB" << endl;
+			}
+
+			MarchingCubeModel::MeshStats	total;
+
+			auto	fileName	= [](const string& path) -> string {
+				size_t	idx		= path.find_last_of('/');
+				return path.substr(idx + 1, path.find_last_of('.') - idx - 1);
+			};
+
+			/*
+				Dedup: models are decoded up front and keyed by their hash
+				(grid, palette, materials), files of same key are compared
+				with first one in full. First file is converted and its
+				output goes to the identical rest, linked when file
+				name is same (name is written inside), written again from
+				mesh otherwise. Streamed jobs keep no mesh, there only files
+				of same name share output.
+			*/
+			vector<BatchJob>	copies;
+			if(dedup) {
+				int					count	= jobs.size();
+				bool				byName	= stream or memLimit > 0;
+				vector<uint64_t>	keys(count, 0);
+				vector<char>		loaded(count, 0);
+#ifdef __unix__
+				#pragma omp parallel for schedule(dynamic, 4) if(memLimit == 0)
+#endif
+				for(int i = 0; i < count; ++i) {
+					VOX	model;
+					if(not model.LoadFile(jobs[i].inPath, flips))
+						continue;	//Load stage reports it
+					loaded[i]	= 1;
+					keys[i]		= model.ContentHash();
 				}
-				cout << 'L' << flush;
 
-				//Optional flip
-				if(flipX or flipY or flipZ) {
-					model.Flip(flipX, flipY, flipZ);
-					cout << 'F' << flush;
+				//Hash match is only candidate, both models are compared before sharing output
+				std::map<std::pair<uint64_t, string>, int>	first;
+				vector<int>									original(count, -1);
+				for(int i = 0; i < count; ++i) {
+					if(not loaded[i])
+						continue;
+					auto	key	= std::make_pair(keys[i], byName? fileName(jobs[i].outPath): string());
+					auto	it	= first.emplace(key, i);
+					if(not it.second)
+						original[i]	= it.first->second;
+				}
+#ifdef __unix__
+				#pragma omp parallel for schedule(dynamic, 4) if(memLimit == 0)
+#endif
+				for(int i = 0; i < count; ++i) {
+					if(original[i] < 0)
+						continue;
+					VOX	model;
+					VOX	other;
+					bool	same	= model.LoadFile(jobs[i].inPath, flips) and other.LoadFile(jobs[original[i]].inPath, flips)
+								and	model.SameContent(other);
+					if(not same)
+						original[i]	= -1;
 				}
 
-				//Convert
-				MarchingCubeModel output;
-				output.offset.Set(offset);
-				output.LoadVoxels(model, scale, upscale);
+				vector<BatchJob>	unique;
+				vector<size_t>		position(count, 0);	//Job => index in unique
+				for(int i = 0; i < count; ++i) {
+					if(original[i] >= 0) {
+						BatchJob&	job	= unique[position[original[i]]];
+						jobs[i].progress	= "=" + std::to_string(job.idx);
+						job.copies.push_back(copies.size());
+						copies.push_back(std::move(jobs[i]));
+						continue;
+					}
+					position[i]	= unique.size();
+					unique.push_back(std::move(jobs[i]));
+				}
+				jobs.swap(unique);
+				cout	<< "[Dedup] " << jobs.size() << " unique of " << count
+						<< " file(s), conversions saved: " << copies.size() << endl;
+			}
 
-				cout << 'V' << flush;
+			//Output of job to its copies, converted mesh is still there unless streamed
+			auto	saveCopies	= [&](BatchJob& job) {
+				string	name	= fileName(job.outPath);
+				string	from	= Helper::GetParentPath(job.outPath) + "/" + name;
+				for(size_t c : job.copies) {
+					BatchJob&	copy	= copies[c];
+					copy.good	= true;
+					if(dryRun)
+						continue;
+					if(fileName(copy.outPath) == name) {
+						string	to	= Helper::GetParentPath(copy.outPath) + "/" + name;
+						copy.good	= Helper::LinkOrCopy(job.outPath, copy.outPath) and (not palette or (
+								Helper::LinkOrCopy(from + ".png", to + ".png")
+							and	Helper::LinkOrCopy(from + ".mtl", to + ".mtl")
+						));
+					} else {
+						copy.good	= saveModel(*job.output, copy.outPath);
+					}
+					if(collision not_eq "")
+						copy.good	= copy.good and Helper::LinkOrCopy(collisionPath(job.outPath), collisionPath(copy.outPath));
+					if(not copy.good)
+						copy.error	= "Cannot write output file!";
+				}
+			};
 
-				string 	 outPath = Helper::ReplaceAll(
-					entry, inDir, outDir
-				);
-				
-				//Naive replace of VOX to OBJ in filename
-				outPath.replace(outPath.length() - 4, 4, ".obj");
+			//Load -> Mesh -> Save pipeline, queues hold at most 2 jobs per worker
+			Pipeline<BatchJob>	pipeline(workers, workers * 2);
 
-				//Fetching model name
-				size_t	idx		= outPath.find_last_of('/');
-				size_t	idxEnd	= outPath.find_last_of('.');
-				output.name 	= outPath.substr(idx + 1, idxEnd - idx - 1);
+			/*
+				Memory limit: peak of every job is guessed from its header,
+				jobs over limit are streamed when output allows it (MC into
+				OBJ) and those still over limit run one at a time. Quarter
+				of limit is kept for pooled grids and meshes between jobs
+				(bigger ones are freed), rest is admitted to jobs.
+			*/
+			if(memLimit > 0) {
+				size_t	pooled		= memLimit / 4;
+				size_t	jobLimit	= memLimit - pooled;
+				context.sources.Limit(pooled / 4);
+				context.grids.Limit(pooled / 2);
+				context.meshes.Limit(pooled / 4);
 
-				//Save
-				output.SaveOBJ(outPath);
+				bool	canStream	=
+						mesher == "mc" and tile == 0 and not vertexColors and not optimize and not dryRun
+					and	normalMode not_eq MarchingCubeModel::SMOOTH_NORMALS and (format == "" or format == "obj");
+				int		count		= jobs.size();
+#ifdef __unix__
+				#pragma omp parallel for schedule(dynamic, 16)
+#endif
+				for(int i = 0; i < count; ++i) {
+					VOX			reader;
+					VOX::Header	header;
+					if(not reader.Inspect(jobs[i].inPath, header))
+						continue;	//Load stage reports it
+					jobs[i].peak	= estimatePeak(header);
+					if(jobs[i].peak > jobLimit and canStream) {
+						jobs[i].streamed	= true;
+						jobs[i].peak		= estimatePeak(header, MarchingCubeModel::slabSize);
+					}
+				}
 
-				cout << "S]" << flush;
+				int		streamed	= 0;
+				int		alone		= 0;
+				for(BatchJob& job : jobs) {
+					streamed	+= job.streamed;
+					alone		+= job.peak > jobLimit;
+				}
+				cout	<< "[Memory] limit: " << (memLimit / 1048576.0) << "MB (jobs: " << (jobLimit / 1048576.0)
+						<< "MB, pools: " << (pooled / 1048576.0) << "MB), streamed: " << streamed
+						<< ", over limit (one at a time): " << alone << endl;
+				pipeline.Limit(jobLimit, [](BatchJob& job) -> size_t {
+					return job.peak;
+				});
+			}
+			size_t	failed	= pipeline.Run(jobs,
+				[&](BatchJob& job) -> bool {
+					job.start	= high_resolution_clock::now();
+					job.model	= context.sources.Acquire();
+					job.model->SetLayout(layout);
+					if(not job.model->LoadFile(job.inPath, flips)) {
+						job.error	= "Cannot open input file!";
+						return false;
+					}
+					job.progress	+= 'L';
+					return true;
+				},
+				[&](BatchJob& job) -> bool {
+#ifdef __unix__
+					//Share cores between concurrent workers instead of oversubscribing
+					omp_set_num_threads(std::max(1, omp_get_num_procs() / int(workers)));
+#endif
+					if(level > 0) {
+						for(int l = 0; l < level; ++l)
+							job.model->Downsample(threshold);
+						job.progress	+= 'D';
+					}
+					if(cavities)
+						job.model->FillCavities();
+					if(collision not_eq "" and not dryRun) {
+						if(not saveCollision(*job.model, job.outPath)) {
+							context.sources.Release(std::move(job.model));
+							job.error	= "Cannot write collision boxes!";
+							return false;
+						}
+						job.progress	+= 'B';
+					}
+					job.output	= context.meshes.Acquire();
+					if(dryRun) {
+						job.stats		= measureModel(*job.model, *job.output);
+						job.progress	+= 'M';
+						context.sources.Release(std::move(job.model));
+						return true;
+					}
+					if(tile > 0) {
+						//Tiles are written right away, nothing left for writer
+						bool	saved	= saveTiles(*job.model, job.outPath);
+						context.sources.Release(std::move(job.model));
+						if(not saved) {
+							job.error	= "Cannot write output tiles!";
+							return false;
+						}
+						job.progress	+= 'T';
+						return true;
+					}
+					if(stream or job.streamed) {
+						//Meshed straight into file, nothing left for writer
+						bool	saved	= saveModel(*job.output, job.outPath, job.model.get());
+						context.sources.Release(std::move(job.model));
+						if(not saved) {
+							job.error	= "Cannot write output file!";
+							return false;
+						}
+						job.progress	+= 'W';
+						return true;
+					}
+					job.cache	= meshModel(*job.model, *job.output);
+					context.sources.Release(std::move(job.model));
+					job.progress	+= 'V';
+					return true;
+				},
+				[&](BatchJob& job) -> bool {
+					bool	written	= dryRun or tile > 0 or stream or job.streamed;
+					bool	saved	= written or saveModel(*job.output, job.outPath);
+					if(saved)
+						saveCopies(job);
+					context.meshes.Release(std::move(job.output));
+					if(not saved) {
+						job.error	= "Cannot write output file!";
+						return false;
+					}
+					if(not written)
+						job.progress	+= 'S';
+					return true;
+				},
+				[&](BatchJob& job, bool good) {
+					job.good	= good;
+					cout << "[" << job.idx << "] " << job.inPath << " [" << job.progress << "]";
+					if(dryRun and good) {
+						printStats(job.stats);
+						total.vertices	+= job.stats.vertices;
+						total.triangles	+= job.stats.triangles;
+					}
+					if(optimize and good and not dryRun and tile == 0)
+						printCache(job.cache);
+					if(timeShow) {
+						cout	<< " (" << duration_cast<milliseconds>(high_resolution_clock::now() - job.start).count()
+								<< "ms)";
+					}
+					cout << endl;
+					if(not good)
+						cerr	<< "[Error] " << job.error << endl;
 
-				if(timeShow) {
-					cout	<< " (" << duration_cast<milliseconds>(high_resolution_clock::now() - start).count()
-							<< "ms)";
+					for(size_t c : job.copies) {
+						BatchJob&	copy	= copies[c];
+						if(not good)
+							copy.error	= "Conversion of same model failed!";
+						cout << "[" << copy.idx << "] " << copy.inPath << " [" << copy.progress << "]";
+						if(dryRun and good) {
+							printStats(job.stats);
+							total.vertices	+= job.stats.vertices;
+							total.triangles	+= job.stats.triangles;
+						}
+						cout << endl;
+						if(not copy.good)
+							cerr	<< "[Error] " << copy.error << endl;
+					}
 				}
+			);
+			for(BatchJob& copy : copies)
+				failed	+= not copy.good;
+			if(dryRun) {
+				cout << "[Total]";
+				printStats(total);
 				cout << endl;
 			}
+
+			//Manifest of shard, merged manifests of all shards list every file once
+			if(sharded and not dryRun) {
+				std::ostringstream	name;
+				name	<< outDir << "/shard." << shardIndex << "-of-" << shardCount << ".csv";
+				ofstream	hManifest(name.str(), std::ios::trunc bitor std::ios::out);
+				hManifest	<< "input,output,bytes,status\n";
+				vector<BatchJob*>	all;
+				for(BatchJob& job : jobs)
+					all.push_back(&job);
+				for(BatchJob& copy : copies)
+					all.push_back(&copy);
+				std::sort(all.begin(), all.end(), [](BatchJob* a, BatchJob* b) -> bool {
+					return a->idx < b->idx;
+				});
+				for(BatchJob* entry : all) {
+					BatchJob&	job	= *entry;
+					hManifest	<< Helper::EscapeCSV(job.inPath.substr(inDir.size() + 1)) << ','
+								<< Helper::EscapeCSV(job.outPath.substr(outDir.size() + 1)) << ','
+								<< job.bytes << ',' << (job.good? "ok": "failed") << '\n';
+				}
+				hManifest.close();
+				if(hManifest.fail()) {
+					cerr	<< "[Error] Cannot write shard manifest!" << endl;
+					return 1;
+				}
+			}
+			if(failed > 0) {
+				cerr	<< "[Error] " << failed << " file(s) failed to convert!" << endl;
+				return 1;
+			}
 		} else {
 			cerr << "[Directory] Input directory is inaccesible, does not exists or is not a directory!" << endl;
 			return 1;
@@ -189,41 +979,84 @@ int main(int argc, char** argv) {
 		string 	in	= Helper::GetAbsolutePath(paramManager.getValueOf("-i"));
 		string	out	= Helper::GetAbsolutePath(paramManager.getValueOf("-o"));
 
+		//Explicit format overrides extension of output path
+		if(format not_eq "" and Helper::ToLower(out.substr(out.find_last_of('.') + 1)) not_eq format)
+			out	+= "." + format;
+
 		//MTL Creation
-		if(paramManager.hasValue("-mtl"))
+		if(paramManager.hasValue("-mtl") and not dryRun)
 			CreateMTL(paramManager.getValueOf("-mtl"), out);
 
 		if(Helper::IsFile(in)) {
 			cout << "[*] " << in << " [" << flush;
 
 			//Load
-			VOX model;
-			if(not model.LoadFile(in)) {
+			VOX model(layout);
+			if(not model.LoadFile(in, flips)) {
 				cerr	<< "[Error] Cannot open input file!" << endl;
 				return 1;
 			}
 			cout << 'L' << flush;
-
-			//Optional flip
-			if(flipX or flipY or flipZ) {
-				model.Flip(flipX, flipY, flipZ);
-				cout << 'F' << flush;
+			if(level > 0) {
+				for(int l = 0; l < level; ++l)
+					model.Downsample(threshold);
+				cout << 'D' << flush;
+			}
+			if(cavities)
+				model.FillCavities();
+			if(collision not_eq "" and not dryRun) {
+				if(not saveCollision(model, out)) {
+					cerr	<< "[Error] Cannot write collision boxes!" << endl;
+					return 1;
+				}
+				cout << 'B' << flush;
 			}
 
 			//Convert & Save
 			MarchingCubeModel output;
-			output.offset.Set(offset);
-			output.LoadVoxels(model, scale, upscale);
+			if(dryRun) {
+				auto	stats	= measureModel(model, output);
+				cout << "M]";
+				printStats(stats);
+				cout << endl;
+				return 0;
+			}
+			if(tile > 0) {
+				if(not saveTiles(model, out)) {
+					cerr	<< "[Error] Cannot write output tiles!" << endl;
+					return 1;
+				}
+				cout << "T]" << endl;
+				return 0;
+			}
+			if(stream) {
+				if(not saveModel(output, out, &model)) {
+					cerr	<< "[Error] Cannot write output file!" << endl;
+					return 1;
+				}
+				cout << "W]" << endl;
+				return 0;
+			}
+			auto	cache	= meshModel(model, output);
 			cout << 'V' << flush;
 
-			//Fetching model name
-			size_t	idx		= out.find_last_of('/');
-			size_t	idxEnd	= out.find_last_of('.');
-			output.name 	= out.substr(idx + 1, idxEnd - idx - 1);
+			//Material groups (glass, metal, ...) get their own entries
+			if(paramManager.hasValue("-mtl")) {
+				string	materials	= output.MaterialLibrary(paramManager.getValueOf("-mtl"));
+				if(materials not_eq "")
+					CreateMTL(paramManager.getValueOf("-mtl"), out, "material.mtl", materials);
+				output.materialEntries	= true;
+			}
 
 			//Save
-			output.SaveOBJ(out);
-			cout << "S]" << endl;
+			if(not saveModel(output, out)) {
+				cerr	<< "[Error] Cannot write output file!" << endl;
+				return 1;
+			}
+			cout << "S]";
+			if(optimize)
+				printCache(cache);
+			cout << endl;
 		} else {
 			cerr << "[File] Input file is inaccesible, does not exists or is not a file!" << endl;
 		}
@@ -233,28 +1066,30 @@ int main(int argc, char** argv) {
 				<< (duration_cast<milliseconds>(
 			high_resolution_clock::now() - overallTime
 		).count() / 1000.0)
-				<< "s" << endl;
+				<< "s (" << Simd::Name(Simd::Active()) << " kernels)" << endl;
 
 	return 0;
 }
 
-void CreateMTL(string texturePath, string mtlPath) {
+void CreateMTL(string texturePath, string mtlPath, string mtlName, string materials) {
 	//Path correction
 	mtlPath	= Helper::GetParentPath(mtlPath);
 
 	//MTL Creation
-	ofstream	hTex(mtlPath + "/material.mtl", std::ios::trunc bitor std::ios::out);
+	ofstream	hTex(mtlPath + "/" + mtlName, std::ios::trunc bitor std::ios::out);
 	if(hTex.good()) {
-		if(not Helper::IsFile(texturePath))
+		//Relative texture path is resolved against MTL location
+		if(not Helper::IsFile(texturePath) and not Helper::IsFile(mtlPath + "/" + texturePath))
 			cerr	<< "[Material/Warning] Texture file from given path does not exists!" << endl;
 
-		hTex	<<	"newmtl texture\n"
+		hTex	<<	"newmtl palette\n"
 					"illum 0\n"
 					"Ka 0.000 0.000 0.000\n"
 					"Kd 1.000 1.000 1.000\n"
 					"Ks 0.000 0.000 0.000\n"
 					"map_Kd " << texturePath
 		<< endl;
+		hTex	<< materials;
 	} else
 		cerr << "[Material] Cannot open nor create material file! (Ignoring)" << endl;
 	hTex.close();